@@ -64,17 +64,6 @@ class assignment2 : public avk::invokee
 		VkBool32 mDisplacementAntiAliasing;
 	};
 
-	/** Struct definition for data used as UBO across different pipelines, containing lightsource data */
-	struct lightsource_data
-	{
-		// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
-		glm::uvec4 mRangesAmbientDirectional;
-		// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
-		glm::uvec4 mRangesPointSpot;
-		// Contains all the data of all the active light sources
-		std::array<avk::lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES> mLightData;
-	};
-
 	// ----------------------------------------------------
 
 public:
@@ -173,7 +162,8 @@ public:
 		// Create GPU buffers which will be populated with frame-specific user data (matrices, settings), and lightsource data:
 		for (auto i = 0; i < context().main_window()->number_of_frames_in_flight(); ++i) {
 			mUniformsBuffer.push_back(context().create_buffer(avk::memory_usage::host_visible, {}, avk::uniform_buffer_meta::create_from_size(sizeof(matrices_and_user_input))));
-			mLightsBuffer.push_back(context().create_buffer(avk::memory_usage::device, {}, avk::uniform_buffer_meta::create_from_size(sizeof(lightsource_data))));
+			mLightsBuffer.push_back(helpers::create_lights_buffer(avk::memory_usage::device, helpers::get_lights().size()));
+			mLightsBufferCapacity.push_back(helpers::get_lights().size());
 		}
 
 		// Initialize the quake_camera, and then add it to our composition (it is a avk::invokee, too):
@@ -568,26 +558,20 @@ public:
 
 		// Update the data in our light sources buffer:
 		auto activeLights = helpers::get_active_lightsources(mLimitNumPointlights);
-		lightsource_data lightsData{
-			glm::uvec4{
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::directional),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::directional)
-			},
-			glm::uvec4{
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::point),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::point),
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::spot),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::spot)
-			},
-			convert_for_gpu_usage<std::array<lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES>>(activeLights, mQuakeCam.view_matrix())
-		};
+		// The buffer only grows if there are more light sources than it can hold. The old one might still be in use by previous frames:
+		auto capacity = helpers::get_lights_buffer_capacity(mLightsBufferCapacity[frameIndex], activeLights.size());
+		if (capacity != mLightsBufferCapacity[frameIndex]) {
+			context().main_window()->handle_lifetime(std::move(currentLightsBuffer));
+			currentLightsBuffer = helpers::create_lights_buffer(avk::memory_usage::device, capacity);
+			mLightsBufferCapacity[frameIndex] = capacity;
+		}
+		std::vector<uint8_t> lightsData(helpers::get_lights_buffer_size(capacity), 0);
+		helpers::write_lightsource_data(activeLights, mQuakeCam.view_matrix(), lightsData.data());
 		auto lightsSemaphore = context().record_and_submit_with_semaphore(
 			// The buffer's backing memory is in a "device" memory region. Therefore, the data must first be copied into 
 			// a host visible buffer (done internally) and then transferred onto the device, into that device memory.
 			// This process must be synchronized => we need to submit the action_type_command to a queue:
-			{ currentLightsBuffer->fill(&lightsData, 0) },
+			{ currentLightsBuffer->fill(lightsData.data(), 0) },
 			*mQueue, 
 			stage::copy
 		);
@@ -708,6 +692,8 @@ private:
 
 	std::vector<avk::buffer> mUniformsBuffer;
 	std::vector<avk::buffer> mLightsBuffer;
+	// Number of light sources each of the mLightsBuffer can hold:
+	std::vector<size_t> mLightsBufferCapacity;
 	
 	float mLastHoleFoundTime = 0.0f;
 	bool  mLastHoleButtonVisible = false;
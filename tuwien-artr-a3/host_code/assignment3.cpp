@@ -50,17 +50,6 @@ class assignment3 : public avk::invokee
 		VkBool32 mIblEnabled;
 	};
 
-	/** Struct definition for data used as UBO across different pipelines, containing lightsource data */
-	struct lightsource_data
-	{
-		// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
-		glm::uvec4 mRangesAmbientDirectional;
-		// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
-		glm::uvec4 mRangesPointSpot;
-		// Contains all the data of all the active light sources
-		std::array<avk::lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES> mLightData;
-	};
-
 	// ----------------------------------------------------
 
 public:
@@ -111,11 +100,10 @@ public:
 			memory_usage::host_visible, {}, // Create its backing memory in a host visible memory region (writable from the host-side)
 			uniform_buffer_meta::create_from_size(sizeof(matrices_and_user_input)) // Meta data tells the type of this buffer => A uniform buffer
 		);
-		mLightsBuffer = context().create_buffer(
-			memory_usage::device, {}, // Create its backing memory in a device-only memory region (takes an additional intermediate step
-									  // to be filled (internally handled) through a host visible buffer, but faster access during rendering.)
-			uniform_buffer_meta::create_from_size(sizeof(lightsource_data)) // Meta data tells the type of this buffer => A uniform buffer
-		);
+		// Create its backing memory in a device-only memory region (takes an additional intermediate step to be filled (internally
+		// handled) through a host visible buffer, but faster access during rendering.) It is a storage buffer, which grows on demand:
+		mLightsBufferCapacity = helpers::get_lights().size();
+		mLightsBuffer = helpers::create_lights_buffer(memory_usage::device, mLightsBufferCapacity);
 
 		// Initialize the cameras, and then add them to our composition (they are `avk::invokee`s too):
 		mOrbitCam.set_translation({ -6.81f, 1.71f, -0.72f });
@@ -947,26 +935,20 @@ public:
 
 		// Update the data in our light sources buffer:
 		auto activeLights = helpers::get_active_lightsources(mLimitNumPointlights);
-		lightsource_data lightsData{
-			glm::uvec4{
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::directional),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::directional)
-			},
-			glm::uvec4{
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::point),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::point),
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::spot),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::spot)
-			},
-			convert_for_gpu_usage<std::array<lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES>>(activeLights, mQuakeCam.view_matrix())
-		};
+		// The buffer only grows if there are more light sources than it can hold. The old one might still be in use by previous frames:
+		auto capacity = helpers::get_lights_buffer_capacity(mLightsBufferCapacity, activeLights.size());
+		if (capacity != mLightsBufferCapacity) {
+			context().main_window()->handle_lifetime(std::move(mLightsBuffer));
+			mLightsBuffer = helpers::create_lights_buffer(memory_usage::device, capacity);
+			mLightsBufferCapacity = capacity;
+		}
+		std::vector<uint8_t> lightsData(helpers::get_lights_buffer_size(capacity), 0);
+		helpers::write_lightsource_data(activeLights, mQuakeCam.view_matrix(), lightsData.data());
 		auto lightsSemaphore = context().record_and_submit_with_semaphore(
 			// The buffer's backing memory is in a "device" memory region. Therefore, the data must first be copied into 
 			// a host visible buffer (done internally) and then transferred onto the device, into that device memory.
 			// This process must be synchronized => we need to submit the action_type_command to a queue:
-			{ mLightsBuffer->fill(&lightsData, 0) },
+			{ mLightsBuffer->fill(lightsData.data(), 0) },
 			*mQueue, 
 			stage::copy
 		);
@@ -1358,6 +1340,8 @@ private:
 
 	avk::buffer mUniformsBuffer;
 	avk::buffer mLightsBuffer;
+	// Number of light sources mLightsBuffer can hold:
+	size_t mLightsBufferCapacity = 0;
 	
 	// ------------------ UI Parameters -------------------
 	/** Factor that determines to which amount normals shall be distorted through normal mapping: */
@@ -740,6 +740,74 @@ namespace helpers
 		return get_lightsource_type_end_index(get_lights(), aLightsourceType);
 	}
 
+	/** Header of the light sources storage buffer, followed by a runtime-sized array of avk::lightsource_gpu_data.
+	 *	Its layout corresponds to the beginning of the LightsourceData buffer block in the shaders (std430).
+	 */
+	struct lightsource_data_header
+	{
+		// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
+		glm::uvec4 mRangesAmbientDirectional;
+		// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
+		glm::uvec4 mRangesPointSpot;
+		// Number of elements which follow the header
+		uint32_t mNumLightsources;
+		uint32_t mPadding[3];
+	};
+
+	/** Returns the size in bytes of a light sources storage buffer which can hold the given number of light sources. */
+	static size_t get_lights_buffer_size(size_t aCapacity)
+	{
+		return sizeof(lightsource_data_header) + std::max(aCapacity, size_t{ 1 }) * sizeof(avk::lightsource_gpu_data);
+	}
+
+	/** Returns the capacity a light sources storage buffer must have to hold the given number of light sources.
+	 *	If the current capacity does not suffice, it grows geometrically, s.t. steadily adding lights only rarely requires a new buffer.
+	 *	@param	aCurrentCapacity		The number of light sources the current buffer can hold
+	 *	@param	aNumLightsources		The number of light sources that shall be stored
+	 */
+	static size_t get_lights_buffer_capacity(size_t aCurrentCapacity, size_t aNumLightsources)
+	{
+		if (aNumLightsources <= aCurrentCapacity) {
+			return aCurrentCapacity;
+		}
+		return std::max(aNumLightsources, aCurrentCapacity + aCurrentCapacity / 2);
+	}
+
+	/** Creates a storage buffer for the given number of light sources.
+	 *	@param	aMemoryUsage			Where the buffer's backing memory shall reside
+	 *	@param	aCapacity				The number of light sources the buffer shall be able to hold
+	 */
+	static avk::buffer create_lights_buffer(avk::memory_usage aMemoryUsage, size_t aCapacity)
+	{
+		return avk::context().create_buffer(aMemoryUsage, {}, avk::storage_buffer_meta::create_from_size(get_lights_buffer_size(aCapacity)));
+	}
+
+	/** Writes the header and the data of the given (sorted) light sources into the given memory,
+	 *	which must be at least get_lights_buffer_size(aLightsources.size()) bytes large.
+	 *	@param	aLightsources			The active light sources, sorted by their types
+	 *	@param	aViewMatrix				The matrix to transform the light sources with
+	 *	@param	aDestination			Where to write to
+	 */
+	static void write_lightsource_data(std::vector<avk::lightsource>& aLightsources, const glm::mat4& aViewMatrix, void* aDestination)
+	{
+		auto* header = static_cast<lightsource_data_header*>(aDestination);
+		header->mRangesAmbientDirectional = glm::uvec4{
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::ambient),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::ambient),
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::directional),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::directional)
+		};
+		header->mRangesPointSpot = glm::uvec4{
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::point),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::point),
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::spot),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::spot)
+		};
+		header->mNumLightsources = static_cast<uint32_t>(aLightsources.size());
+		auto gpuData = avk::convert_for_gpu_usage<std::vector<avk::lightsource_gpu_data>>(aLightsources, aViewMatrix);
+		std::memcpy(header + 1, gpuData.data(), gpuData.size() * sizeof(avk::lightsource_gpu_data));
+	}
+
 	// create and initialize a lightsource editor
 	static lights_editor create_lightsource_editor(avk::queue& aQueueToSubmitTo, bool aGuiEnabled)
 	{
@@ -33,15 +33,17 @@ layout(push_constant) uniform PushConstantsBlock { PushConstants pushConstants;
 // Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
 layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
 
-// "mLightsources" uniform buffer containing all the light source data:
-layout(set = 1, binding = 1) uniform LightsourceData
+// "mLightsources" storage buffer containing all the light source data (its size is only limited by the host-side buffer):
+layout(set = 1, binding = 1) readonly buffer LightsourceData
 {
 	// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
 	uvec4 mRangesAmbientDirectional;
 	// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
 	uvec4 mRangesPointSpot;
+	// Number of elements in mLightData
+	uint mNumLightsources;
 	// Contains all the data of all the active light sources
-	LightsourceGpuData mLightData[MAX_NUMBER_OF_LIGHTSOURCES];
+	LightsourceGpuData mLightData[];
 } uboLights;
 // -------------------------------------------------------
 
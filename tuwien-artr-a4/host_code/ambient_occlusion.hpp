@@ -7,6 +7,22 @@ class ambient_occlusion : public avk::invokee
 		float mSampleRadius;
 		float mDarkeningFactor;
 		int mNumSamples;
+		int mFrameIndex;
+	};
+
+	struct push_constants_for_gtao {
+		float mRadius;
+		float mDarkeningFactor;
+		int mNumDirections;
+		int mNumSteps;
+		int mFrameIndex;
+	};
+
+	struct push_constants_for_temporal_accumulation {
+		glm::mat4 mViewToHistoryClipMatrix;
+		float mAlpha;
+		float mDepthTolerance;
+		int mHistoryValid;
 	};
 
 	struct push_constants_for_blur {
@@ -15,6 +31,17 @@ class ambient_occlusion : public avk::invokee
 		int mKernelSize;
 	};
 
+	struct push_constants_for_separable_blur {
+		float mSpatial;
+		float mIntensity;
+		glm::ivec2 mDirection;
+	};
+
+	struct push_constants_for_apply {
+		int mUpsample;
+		float mDepthSharpness;
+	};
+
 public:
 	/**	An invokee which adds ambient occlusion as a post processing effect
 	 */
@@ -27,32 +54,49 @@ public:
 	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
 	 *	@param	aQueue					Stores an avk::queue* internally for future use, which has been created previously.
 	 *	@param	aDescriptorCache		A descriptor cache that shall be used (possibly allowing descriptor re-use from other invokees)
-	 *	@param	aUniformsBuffer			A buffer containing user input and current frame's data
+	 *	@param	aFrameGraph				The frame graph which this invokee's passes are added to every frame
+	 *	@param	aUniformsBuffers		One buffer per frame in flight, containing user input and that frame's data
 	 *	@param	aSourceColor			Rendered results from previous steps where ambient occlusion shall be added,
 	 *									expected to be given in SHADER_READ_ONLY_OPTIMAL layout.
 	 *	@param	aSourceDepth			G-Buffer depth values associated to the color values in aSourceColors
 	 *	@param	aSourceUvNormal			G-Buffer attachment containing UV coordinates in .rg and spherical normals in .ba
 	 *	@param	aDestinationImageView	Destination image view which shall receive the rendered results after the ambient occlusion effect has been added
-	 *									Expected to be given in THE SAME FORMAT as aIntermediateImage and in GENERAL layout.
+	 *									Expected to be given in GENERAL layout. The occlusion factors are stored in a transient image of the same format.
 	 */
-	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, avk::buffer aUniformsBuffer, avk::image_view aSourceColor, avk::image_view aSourceDepth, avk::image_view aSourceUvNormal, avk::image_view aDestinationImageView)
+	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, frame_graph& aFrameGraph, std::vector<avk::buffer> aUniformsBuffers, avk::image_view aSourceColor, avk::image_view aSourceDepth, avk::image_view aSourceUvNormal, avk::image_view aDestinationImageView)
 	{
 		using namespace avk;
 
 		mQueue = &aQueue;
 		mDescriptorCache = std::move(aDescriptorCache);
-		mUniformsBuffer = std::move(aUniformsBuffer);
+		mFrameGraph = &aFrameGraph;
+		mUniformsBuffers = std::move(aUniformsBuffers);
 		mSrcColor = std::move(aSourceColor);
 		mSrcDepth = std::move(aSourceDepth);
 		mSrcUvNrm = std::move(aSourceUvNormal);
 		mDstResults = std::move(aDestinationImageView);
 
-		mIntermediateImage = context().create_image_view_from_template(mDstResults.get());
+		// Create the images for the half resolution mode, which hold the downsampled G-Buffer depth and normals, and the occlusion factors:
+		const auto w = (mDstResults->get_image().width() + 1u) / 2u;
+		const auto h = (mDstResults->get_image().height() + 1u) / 2u;
+		auto halfResDepth = context().create_image(w, h, vk::Format::eR32Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto halfResUvNrm = context().create_image(w, h, vk::Format::eR32G32B32A32Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto halfResOcclusionFactors = context().create_image(w, h, mDstResults->get_image().create_info().format, 1, memory_usage::device, image_usage::general_storage_image);
+		auto halfResBlurredOcclusionFactors = context().create_image(w, h, mDstResults->get_image().create_info().format, 1, memory_usage::device, image_usage::general_storage_image);
+
 		auto fen = context().record_and_submit_with_fence(command::gather(
-			// Transition the storage image into GENERAL layout and keep it in that layout forever:
-			sync::image_memory_barrier(mIntermediateImage->get_image(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+			// Transition the half resolution images into GENERAL layout and keep them in that layout forever:
+			sync::image_memory_barrier(halfResDepth.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(halfResUvNrm.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(halfResOcclusionFactors.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(halfResBlurredOcclusionFactors.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
 		), *mQueue);
 		fen->wait_until_signalled();
+
+		mHalfResDepth = context().create_image_view(std::move(halfResDepth));
+		mHalfResUvNrm = context().create_image_view(std::move(halfResUvNrm));
+		mHalfResOcclusionFactors = context().create_image_view(std::move(halfResOcclusionFactors));
+		mHalfResBlurredOcclusionFactors = context().create_image_view(std::move(halfResBlurredOcclusionFactors));
 	}
 
 	/**	Returns the result of the GPU timer query, which indicates how long the SSAO effect approximately took.
@@ -62,7 +106,7 @@ public:
 		if (!mSsaoEnabled) {
 			return 0.0f;
 		}
-		return helpers::get_timing_interval_in_ms(std::format("ssao {}", mPingPong));
+		return helpers::get_timing_interval_in_ms(std::format("ssao {}", helpers::get_oldest_in_flight_index()));
 	}
 
 	// Return offsets for sampling the neighborhood during SSAO:
@@ -115,15 +159,11 @@ public:
 	}
 	
 	// Create all the compute pipelines used for the post processing effect(s),
-	// prepare some command buffers with pipeline barriers to synchronize with subsequent commands,
 	// create a new ImGui window that allows to enable/disable ambient occlusion, and to modify parameters:
 	void initialize() override 
 	{
 		using namespace avk;
 
-		// Create a command pool for allocating single-use (hence, transient) command buffers:
-		mCommandPool = context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient);
-
 		// Use this invokee's updater to enable shader hot reloading
 		mUpdater.emplace();
 
@@ -157,7 +197,7 @@ public:
 			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
 			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
 			descriptor_binding<image_view_as_storage_image>(0, 2, 1u),
-			descriptor_binding(1, 0, mUniformsBuffer),
+			descriptor_binding(1, 0, mUniformsBuffers[0]), // Doesn't have to be the exact buffer, but one that describes the correct layout for the pipeline.
 			descriptor_binding(2, 0, mRandomSamplesBuffer),
 			descriptor_binding(3, 0, mNoiseBuffer)
 		);
@@ -165,6 +205,32 @@ public:
 		mUpdater->on(shader_files_changed_event(mOcclusionFactorsPipeline.as_reference()))
 			.update(mOcclusionFactorsPipeline);
 
+		mGtaoPipeline = context().create_compute_pipeline_for(
+			"shaders/gtao.comp",
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(push_constants_for_gtao) },
+			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 2, 1u),
+			descriptor_binding(1, 0, mUniformsBuffers[0])
+		);
+
+		mUpdater->on(shader_files_changed_event(mGtaoPipeline.as_reference()))
+			.update(mGtaoPipeline);
+
+		mTemporalAccumulationPipeline = context().create_compute_pipeline_for(
+			"shaders/ssao_temporal_accumulation.comp",
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(push_constants_for_temporal_accumulation) },
+			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 2, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 3, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 4, 1u),
+			descriptor_binding(1, 0, mUniformsBuffers[0])
+		);
+
+		mUpdater->on(shader_files_changed_event(mTemporalAccumulationPipeline.as_reference()))
+			.update(mTemporalAccumulationPipeline);
+
 		//
 		// TODO Task 2: Add a pipeline to blur the occlusion factors
 		//
@@ -180,11 +246,37 @@ public:
 		mUpdater->on(shader_files_changed_event(mBlurOcclusionFactorsPipeline.as_reference()))
 			.update(mBlurOcclusionFactorsPipeline);
 
+		// The kernel size of the separable blur is a specialization constant, s.t. its loops can be unrolled:
+		mSeparableBlurOcclusionFactorsPipeline = context().create_compute_pipeline_for(
+			compute_shader("shaders/blur_occlusion_factors_separable.comp").set_specialization_constant(0u, static_cast<int32_t>(mBlurKernelSize)),
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(push_constants_for_separable_blur) },
+			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 1, 1u)
+		);
+
+		mUpdater->on(shader_files_changed_event(mSeparableBlurOcclusionFactorsPipeline.as_reference()))
+			.update(mSeparableBlurOcclusionFactorsPipeline);
+
+		mDownsampleDepthNormalsPipeline = context().create_compute_pipeline_for(
+			"shaders/downsample_depth_normals.comp",
+			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 2, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 3, 1u)
+		);
+
+		mUpdater->on(shader_files_changed_event(mDownsampleDepthNormalsPipeline.as_reference()))
+			.update(mDownsampleDepthNormalsPipeline);
+
 		mApplyOcclusionFactorsPipeline = context().create_compute_pipeline_for(
 			"shaders/apply_occlusion_factors.comp",
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(push_constants_for_apply) },
 			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
 			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
-			descriptor_binding<image_view_as_storage_image>(0, 2, 1u)
+			descriptor_binding<image_view_as_storage_image>(0, 2, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 3, 1u),
+			descriptor_binding<image_view_as_sampled_image>(0, 4, 1u),
+			descriptor_binding(1, 0, mUniformsBuffers[0])
 		);
 
 		mUpdater->on(shader_files_changed_event(mApplyOcclusionFactorsPipeline.as_reference()))
@@ -200,17 +292,31 @@ public:
 		imguiManager->add_callback([this](){
 			ImGui::Begin("Ambient Occlusion Settings");
 			ImGui::SetWindowPos(ImVec2(295.0f, 10.0f), ImGuiCond_FirstUseEver);
-			ImGui::SetWindowSize(ImVec2(220.0f, 160.0f), ImGuiCond_FirstUseEver);
+			ImGui::SetWindowSize(ImVec2(220.0f, 320.0f), ImGuiCond_FirstUseEver);
 			ImGui::Checkbox("enabled", &mSsaoEnabled);
+			ImGui::SameLine();
+			ImGui::Checkbox("async compute", &mAsyncCompute);
+			ImGui::Checkbox("half resolution", &mHalfResolution);
+			static const char* sAlgorithmItems[] = { "hemisphere sampling (SSAO)", "horizon-based (GTAO)" };
+			ImGui::Combo("algorithm", &mAlgorithm, sAlgorithmItems, IM_ARRAYSIZE(sAlgorithmItems));
+			// Keep the last timing of each algorithm, s.t. they can be compared side by side:
+			mAlgorithmDurations[mAlgorithm] = duration();
+			ImGui::Text("%.3f ms SSAO | %.3f ms GTAO", mAlgorithmDurations[0], mAlgorithmDurations[1]);
 			ImGui::SliderInt("#samples", &mNumSamples, 1, 128);
+			ImGui::SliderInt("#directions (GTAO)", &mGtaoNumDirections, 1, 8);
+			ImGui::SliderInt("#steps per direction (GTAO)", &mGtaoNumSteps, 1, 16);
+			ImGui::Checkbox("temporal", &mTemporal);
+			ImGui::SliderInt("#samples per frame (temporal)", &mTemporalNumSamples, 1, 32);
+			ImGui::SliderFloat("temporal alpha", &mTemporalAlpha, 0.01f, 1.0f);
 			ImGui::SliderFloat("radius", &mSampleRadius, 0.0f, 6.0f);
 			ImGui::SliderFloat("darkening factor", &mDarkeningFactor, 0.0f, 5.0f);
 			static const char* sOcclusionItems[] = { "display occlusion factors", "apply occlusion factors" };
 			ImGui::Combo("occlusion factors", &mApplyOcclusionFactors, sOcclusionItems, IM_ARRAYSIZE(sOcclusionItems));
-			static const char* sBlurItems[] = { "don't blur occlusion factors", "blur occlusion factors" };
+			static const char* sBlurItems[] = { "don't blur occlusion factors", "blur occlusion factors", "blur occlusion factors (separable)" };
 			ImGui::Combo("blur", &mBlurOcclusionFactors, sBlurItems, IM_ARRAYSIZE(sBlurItems));
 			ImGui::SliderFloat("sigma intensity", &mIntensity, 0.1f, 10.0f);
 			ImGui::SliderFloat("sigma spatial", &mSpatial, 0.1f, 10.0f);
+			ImGui::SliderFloat("upsampling depth sharpness", &mUpsampleDepthSharpness, 1.0f, 200.0f);
 			ImGui::End();
 		});
 	}
@@ -222,151 +328,350 @@ public:
 
 	}
 
-	// Create a new command buffer every frame, record instructions into it, and submit it to the graphics queue:
+	// Add this frame's passes to the frame graph, which derives the barriers between them from their declared accesses:
 	void render() override 
 	{
 		using namespace avk;
 
-		mOcclusionFactorsPushConstants.mNumSamples = mNumSamples;
+		const auto frameId = context().main_window()->current_frame();
+		mOcclusionFactorsPushConstants.mNumSamples = mTemporal ? mTemporalNumSamples : mNumSamples;
+		mOcclusionFactorsPushConstants.mFrameIndex = mTemporal ? static_cast<int>(frameId % 65536) : -1;
 		mOcclusionFactorsPushConstants.mSampleRadius = mSampleRadius;
 		mOcclusionFactorsPushConstants.mDarkeningFactor = mDarkeningFactor;
 
+		mGtaoPushConstants.mRadius = mSampleRadius;
+		mGtaoPushConstants.mDarkeningFactor = mDarkeningFactor;
+		mGtaoPushConstants.mNumDirections = mGtaoNumDirections;
+		mGtaoPushConstants.mNumSteps = mGtaoNumSteps;
+		mGtaoPushConstants.mFrameIndex = mOcclusionFactorsPushConstants.mFrameIndex;
+
 		mBlurPushConstants.mIntensity = mIntensity;
 		mBlurPushConstants.mSpatial = mSpatial;
-		mBlurPushConstants.mKernelSize = 5;
+		mBlurPushConstants.mKernelSize = mBlurKernelSize;
 
-		auto cmdBfr = mCommandPool->alloc_command_buffer(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		mSeparableBlurPushConstants.mIntensity = mIntensity;
+		mSeparableBlurPushConstants.mSpatial = mSpatial;
 
-		context().record({ // Record a bunch of commands (which can be a mix of state-type commands and action-type commands):
+		const auto inFlightIndex = context().main_window()->in_flight_index_for_frame();
 
-			command::custom_commands([this](avk::command_buffer_t& cb) {
-
-				if (mSsaoEnabled) {
-					// ---------------------- If SSAO is enabled perform the following actions --------------------------
+		if (!mSsaoEnabled) {
+			// -------------------------- If SSAO is disabled, do nothing but blit ------------------------------
+			mFrameGraph->add_pass("ssao: blit")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcColor, stage::blit, access::transfer_read, layout::transfer_src)
+				.writes(mDstResults, stage::blit, access::transfer_write)
+				.records([this](avk::command_buffer_t& cb) {
+					cb.record(blit_image(mSrcColor->get_image(), layout::transfer_src, mDstResults->get_image(), layout::general));
+				});
+			return;
+		}
 
-					mPingPong = 1 - mPingPong;
-					helpers::record_timing_interval_start(cb.handle(), std::format("ssao {}", mPingPong));
+		// ---------------------- If SSAO is enabled perform the following actions --------------------------
+		// In half resolution mode, the occlusion factors are computed from a downsampled G-Buffer, and upsampled when they are applied:
+		// (The mode is captured, s.t. the passes are recorded consistently, even if it is changed via ImGui in the meantime.)
+		const bool halfRes = mHalfResolution;
+		if (!halfRes) {
+			mFrameGraph->declare_transient_image("ssao occlusion factors", mDstResults);
+		}
+		auto* depth = halfRes ? &mHalfResDepth : &mSrcDepth;
+		auto* uvNrm = halfRes ? &mHalfResUvNrm : &mSrcUvNrm;
+		const auto depthLayout = halfRes ? layout::general : layout::shader_read_only_optimal;
+
+		if (halfRes) {
+			// ------> 0th step: Downsample depth and normals, picking the min. and max. depth of each 2x2 block in a checkerboard pattern
+			mFrameGraph->add_pass("ssao: downsample depth and normals")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcDepth, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcUvNrm, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.writes(mHalfResDepth, stage::compute_shader, access::shader_storage_write)
+				.writes(mHalfResUvNrm, stage::compute_shader, access::shader_storage_write)
+				.records([this, inFlightIndex](avk::command_buffer_t& cb) {
+					helpers::record_timing_interval_start(cb.handle(), std::format("ssao {}", inFlightIndex));
+
+					const auto w = mHalfResDepth->get_image().width();
+					const auto h = mHalfResDepth->get_image().height();
+					cb.record(avk::command::bind_pipeline(mDownsampleDepthNormalsPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mDownsampleDepthNormalsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 2, mHalfResDepth->as_storage_image(layout::general)),
+						descriptor_binding(0, 3, mHalfResUvNrm->as_storage_image(layout::general)),
+					})));
+					cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+				});
+		}
 
-					const auto w = mDstResults->get_image().width();
-					const auto h = mDstResults->get_image().height();
+		// ------> 1st step (and also SSAO's main step): Generate the occlusion factors
+		auto& occlusionFactorsPass = mFrameGraph->add_pass("ssao: occlusion factors")
+			.on_async_compute_queue(mAsyncCompute)
+			.reads(*depth, stage::compute_shader, access::shader_sampled_read, depthLayout)
+			.reads(*uvNrm, stage::compute_shader, access::shader_sampled_read, depthLayout)
+			.records([this, inFlightIndex, halfRes, gtao = (1 == mAlgorithm), depth, uvNrm, depthLayout](avk::command_buffer_t& cb) {
+				if (!halfRes) {
+					helpers::record_timing_interval_start(cb.handle(), std::format("ssao {}", inFlightIndex));
+				}
 
-					// ------> 1st step (and also SSAO's main step): Generate the occlusion factors
+				auto& occlusionFactors = occlusion_factors(halfRes);
+				const auto w = occlusionFactors->get_image().width();
+				const auto h = occlusionFactors->get_image().height();
+				if (gtao) {
+					cb.record(avk::command::bind_pipeline(mGtaoPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mGtaoPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, (*depth)->as_sampled_image(depthLayout)),
+						descriptor_binding(0, 1, (*uvNrm)->as_sampled_image(depthLayout)),
+						descriptor_binding(0, 2, occlusionFactors->as_storage_image(layout::general)),
+						descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
+					})));
+					cb.record(avk::command::push_constants(mGtaoPipeline->layout(), mGtaoPushConstants));
+				}
+				else {
 					cb.record(avk::command::bind_pipeline(mOcclusionFactorsPipeline.as_reference()));
 					cb.record(avk::command::bind_descriptors(mOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-						descriptor_binding(0, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
-						descriptor_binding(0, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
-						descriptor_binding(0, 2, mIntermediateImage->as_storage_image(layout::general)),
-						descriptor_binding(1, 0, mUniformsBuffer),
+						descriptor_binding(0, 0, (*depth)->as_sampled_image(depthLayout)),
+						descriptor_binding(0, 1, (*uvNrm)->as_sampled_image(depthLayout)),
+						descriptor_binding(0, 2, occlusionFactors->as_storage_image(layout::general)),
+						descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
 						descriptor_binding(2, 0, mRandomSamplesBuffer),
 						descriptor_binding(3, 0, mNoiseBuffer),
 					})));
 					cb.record(avk::command::push_constants(mOcclusionFactorsPipeline->layout(), mOcclusionFactorsPushConstants));
+				}
+				cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+			});
+		writes_occlusion_factors(halfRes, occlusionFactorsPass, stage::compute_shader, access::shader_storage_write);
+
+		if (mTemporal) {
+			// ------> 1st step (continued): Blend the occlusion factors with the reprojected ones of the previous frames
+			const auto w = halfRes ? mHalfResDepth->get_image().width() : mDstResults->get_image().width();
+			const auto h = halfRes ? mHalfResDepth->get_image().height() : mDstResults->get_image().height();
+			if (mTemporalHistory.empty() || mTemporalHistory[0]->get_image().width() != w || mTemporalHistory[0]->get_image().height() != h) {
+				create_temporal_history_images(w, h);
+			}
+
+			auto* camera = current_composition()->element_by_type<quake_camera>();
+			const auto viewProjMatrix = camera->projection_matrix() * camera->view_matrix();
+			mTemporalPushConstants.mViewToHistoryClipMatrix = mTemporalHistoryViewProjMatrix * glm::inverse(camera->view_matrix());
+			mTemporalPushConstants.mAlpha = mTemporalAlpha;
+			mTemporalPushConstants.mDepthTolerance = mTemporalDepthTolerance;
+			mTemporalPushConstants.mHistoryValid = mTemporalHistoryFrameId == frameId - 1 ? 1 : 0;
+
+			// The history images are used alternately, s.t. one is read while the other one is written:
+			auto& srcHistory = mTemporalHistory[(frameId + 1) % 2];
+			auto& dstHistory = mTemporalHistory[frameId % 2];
+			auto& temporalPass = mFrameGraph->add_pass("ssao: temporal accumulation")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(*depth, stage::compute_shader, access::shader_sampled_read, depthLayout)
+				.reads(srcHistory, stage::compute_shader, access::shader_sampled_read)
+				.writes(dstHistory, stage::compute_shader, access::shader_storage_write)
+				.records([this, inFlightIndex, halfRes, depth, depthLayout, &srcHistory, &dstHistory](avk::command_buffer_t& cb) {
+					auto& occlusionFactors = occlusion_factors(halfRes);
+					const auto w = occlusionFactors->get_image().width();
+					const auto h = occlusionFactors->get_image().height();
+					cb.record(avk::command::bind_pipeline(mTemporalAccumulationPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mTemporalAccumulationPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, occlusionFactors->as_sampled_image(layout::general)),
+						descriptor_binding(0, 1, (*depth)->as_sampled_image(depthLayout)),
+						descriptor_binding(0, 2, srcHistory->as_sampled_image(layout::general)),
+						descriptor_binding(0, 3, occlusionFactors->as_storage_image(layout::general)),
+						descriptor_binding(0, 4, dstHistory->as_storage_image(layout::general)),
+						descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
+					})));
+					cb.record(avk::command::push_constants(mTemporalAccumulationPipeline->layout(), mTemporalPushConstants));
 					cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+				});
+			reads_occlusion_factors(halfRes, temporalPass, stage::compute_shader, access::shader_sampled_read);
+			writes_occlusion_factors(halfRes, temporalPass, stage::compute_shader, access::shader_storage_write);
 
-					if (mBlurOcclusionFactors) {
-						// ------> 2nd step: Blur the occlusion factors
-						//
-						// TODO Task 2: Blur the occlusion factors by using compute shader(s)!
-						//              Make sure to write the blurred results into mIntermediateImage!
-						//              Furthermore, establish proper synchronization! (It is okay to use a global memory barrier, you don't have to use image memory barriers.)
-						//
-
-						cb.record(sync::global_memory_barrier(
-							stage::compute_shader >> stage::compute_shader,
-							access::shader_storage_write >> access::shader_read
-						));
-
-						cb.record(avk::command::bind_pipeline(mBlurOcclusionFactorsPipeline.as_reference()));
-						cb.record(avk::command::bind_descriptors(mBlurOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-							descriptor_binding(0, 0, mIntermediateImage->as_sampled_image(layout::general)), // uOcclusionFactors
-							descriptor_binding(0, 1, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)), // uDepth
-							descriptor_binding(0, 2, mIntermediateImage->as_storage_image(layout::general)), // uDst
-						})));
-						cb.record(avk::command::push_constants(mBlurOcclusionFactorsPipeline->layout(), mBlurPushConstants));
-						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
-					}
+			mTemporalHistoryFrameId = frameId;
+			mTemporalHistoryViewProjMatrix = viewProjMatrix;
+		}
 
-					if (mApplyOcclusionFactors) {
-						// ------> 3rd step: apply the occlusion factors
-						cb.record(sync::global_memory_barrier(
-							// We have to wait for previous compute finish, before we may invoke another compute shader that needs to access the same data:
-							stage::compute_shader        >> stage::compute_shader,
-							// The compute's image writes must be made available and visible to the next compute shader's read access:
-							access::shader_storage_write >> access::shader_read
-						));
-						cb.record(avk::command::bind_pipeline(mApplyOcclusionFactorsPipeline.as_reference()));
-						cb.record(avk::command::bind_descriptors(mApplyOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-							descriptor_binding(0, 0, mSrcColor->as_sampled_image(layout::read_only_optimal)),
-							descriptor_binding(0, 1, mIntermediateImage->as_sampled_image(layout::general)),
-							descriptor_binding(0, 2, mDstResults->as_storage_image(layout::general)),
+		if (1 == mBlurOcclusionFactors) {
+			// ------> 2nd step: Blur the occlusion factors
+			//
+			// TODO Task 2: Blur the occlusion factors by using compute shader(s)!
+			//              Make sure to write the blurred results into the transient occlusion factors image!
+			//              Synchronization is derived by the frame graph from the accesses declared below.
+			//
+			auto& blurPass = mFrameGraph->add_pass("ssao: blur")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(*depth, stage::compute_shader, access::shader_sampled_read, depthLayout)
+				.records([this, halfRes, depth, depthLayout](avk::command_buffer_t& cb) {
+					auto& occlusionFactors = occlusion_factors(halfRes);
+					const auto w = occlusionFactors->get_image().width();
+					const auto h = occlusionFactors->get_image().height();
+					cb.record(avk::command::bind_pipeline(mBlurOcclusionFactorsPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mBlurOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, occlusionFactors->as_sampled_image(layout::general)), // uOcclusionFactors
+						descriptor_binding(0, 1, (*depth)->as_sampled_image(depthLayout)), // uDepth
+						descriptor_binding(0, 2, occlusionFactors->as_storage_image(layout::general)), // uDst
+					})));
+					cb.record(avk::command::push_constants(mBlurOcclusionFactorsPipeline->layout(), mBlurPushConstants));
+					cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+				});
+			reads_occlusion_factors(halfRes, blurPass, stage::compute_shader, access::shader_sampled_read);
+			writes_occlusion_factors(halfRes, blurPass, stage::compute_shader, access::shader_storage_write);
+		}
+		else if (2 == mBlurOcclusionFactors) {
+			// ------> 2nd step (alternatively): Blur the occlusion factors separably, first horizontally into an intermediate image, then vertically back
+			if (!halfRes) {
+				mFrameGraph->declare_transient_image("ssao horizontally blurred occlusion factors", mDstResults);
+			}
+			for (bool vertical : { false, true }) {
+				auto& blurPass = mFrameGraph->add_pass(vertical ? "ssao: blur vertically" : "ssao: blur horizontally")
+					.on_async_compute_queue(mAsyncCompute)
+					.records([this, halfRes, vertical](avk::command_buffer_t& cb) {
+						auto& src = occlusion_factors(halfRes, vertical);
+						auto& dst = occlusion_factors(halfRes, !vertical);
+						const auto w = dst->get_image().width();
+						const auto h = dst->get_image().height();
+						auto pushConstants = mSeparableBlurPushConstants;
+						pushConstants.mDirection = vertical ? glm::ivec2{ 0, 1 } : glm::ivec2{ 1, 0 };
+						cb.record(avk::command::bind_pipeline(mSeparableBlurOcclusionFactorsPipeline.as_reference()));
+						cb.record(avk::command::bind_descriptors(mSeparableBlurOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+							descriptor_binding(0, 0, src->as_sampled_image(layout::general)), // uOcclusionFactors
+							descriptor_binding(0, 1, dst->as_storage_image(layout::general)), // uDst
 						})));
+						cb.record(avk::command::push_constants(mSeparableBlurOcclusionFactorsPipeline->layout(), pushConstants));
 						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+					});
+				reads_occlusion_factors(halfRes, blurPass, stage::compute_shader, access::shader_sampled_read, vertical);
+				writes_occlusion_factors(halfRes, blurPass, stage::compute_shader, access::shader_storage_write, !vertical);
+			}
+		}
+
+		if (mApplyOcclusionFactors) {
+			// ------> 3rd step: apply the occlusion factors (joint-bilateral upsampling them in half resolution mode)
+			mApplyPushConstants.mUpsample = halfRes ? 1 : 0;
+			mApplyPushConstants.mDepthSharpness = mUpsampleDepthSharpness;
+
+			auto& applyPass = mFrameGraph->add_pass("ssao: apply occlusion factors")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcColor, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcDepth, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(*depth, stage::compute_shader, access::shader_sampled_read, depthLayout)
+				.writes(mDstResults, stage::compute_shader, access::shader_storage_write)
+				.records([this, inFlightIndex, halfRes, depth, depthLayout](avk::command_buffer_t& cb) {
+					const auto w = mDstResults->get_image().width();
+					const auto h = mDstResults->get_image().height();
+					cb.record(avk::command::bind_pipeline(mApplyOcclusionFactorsPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mApplyOcclusionFactorsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mSrcColor->as_sampled_image(layout::read_only_optimal)),
+						descriptor_binding(0, 1, occlusion_factors(halfRes)->as_sampled_image(layout::general)),
+						descriptor_binding(0, 2, mDstResults->as_storage_image(layout::general)),
+						descriptor_binding(0, 3, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 4, (*depth)->as_sampled_image(depthLayout)),
+						descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
+					})));
+					cb.record(avk::command::push_constants(mApplyOcclusionFactorsPipeline->layout(), mApplyPushConstants));
+					cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
+
+					helpers::record_timing_interval_end(cb.handle(), std::format("ssao {}", inFlightIndex));
+				});
+			reads_occlusion_factors(halfRes, applyPass, stage::compute_shader, access::shader_sampled_read);
+		}
+		else {
+			// Just copy over (or blit, if they have been computed in half resolution), to display the occlusion factors on the screen:
+			auto& displayPass = mFrameGraph->add_pass("ssao: display occlusion factors")
+				.on_async_compute_queue(mAsyncCompute)
+				.writes(mDstResults, stage::copy | stage::blit, access::transfer_write)
+				.records([this, inFlightIndex, halfRes](avk::command_buffer_t& cb) {
+					if (halfRes) {
+						cb.record(blit_image(mHalfResOcclusionFactors->get_image(), layout::general, mDstResults->get_image(), layout::general, vk::ImageAspectFlagBits::eColor, vk::Filter::eLinear));
 					}
 					else {
-						// Just copy over, to display the occlusion factors on the screen:
-						cb.record(sync::global_memory_barrier(
-							// The compute shader must complete execution before the transfer operation (copy) may resume:
-							stage::compute_shader        >> stage::copy,
-							// The compute's image writes must be made available and visible to the transfer operation's memory access type:
-							access::shader_storage_write >> access::transfer_read
-						));
-						cb.record(copy_image_to_another(mIntermediateImage->get_image(), layout::general, mDstResults->get_image(), layout::general));
+						cb.record(copy_image_to_another(mFrameGraph->transient_image("ssao occlusion factors")->get_image(), layout::general, mDstResults->get_image(), layout::general));
 					}
 
-					helpers::record_timing_interval_end(cb.handle(), std::format("ssao {}", mPingPong));
-				}
-
-				// -------------------------- If SSAO is disabled, do nothing but blit ------------------------------
-				else {
-					cb.record(
-						sync::image_memory_barrier(mSrcColor->get_image(),
-							// Any previous color attachment writes or compute shader writes must have completed before we may blit:
-							stage::color_attachment_output | stage::compute_shader        >> stage::blit,
-							// Writes must be made available and visible to the transfer read:
-							access::color_attachment_write | access::shader_storage_write >> access::transfer_read
-						).with_layout_transition(layout::shader_read_only_optimal >> layout::transfer_src)
-					);
-					cb.record(blit_image(mSrcColor->get_image(), layout::transfer_src, mDstResults->get_image(), layout::general));
-					cb.record(
-						sync::image_memory_barrier(mSrcColor->get_image(),
-							// As soon as blit is done, change layout back, and assume that afterwards, there will be compute or transfer accessing this image:
-							stage::blit   >>  stage::compute_shader  | stage::transfer,
-							access::none  >>  access::none
-						).with_layout_transition(layout::transfer_src >> layout::shader_read_only_optimal)
-					);
-				}
-
-				// In any case, sync with subsequent compute or transfer commands:
-				cb.record(sync::global_memory_barrier(
-					// Compute or transfer operations must complete before other compute or transfer operations may proceed:
-					stage::compute_shader | stage::transfer               >> stage::compute_shader | stage::transfer,
-					// Particularly write accesses must be made available, and we just assume here that next access for resources will be read:
-					access::shader_storage_write | access::transfer_write >> access::shader_read | access::transfer_read
-				));
-			})
-			
-		}) // End of command recording
-		.into_command_buffer(cmdBfr)
-		.then_submit_to(*mQueue)
-		.submit();
-
-		// Use a convenience function of avk::window to take care of the command buffer's lifetime:
-		// It will get deleted in the future after #concurrent-frames have passed by.
-		context().main_window()->handle_lifetime(std::move(cmdBfr));
+					helpers::record_timing_interval_end(cb.handle(), std::format("ssao {}", inFlightIndex));
+				});
+			reads_occlusion_factors(halfRes, displayPass, stage::copy | stage::blit, access::transfer_read);
+		}
 	}
 			
 private:
+	/**	(Re-)creates the two history images of the temporal mode with the given size, which is the size of the occlusion factors.
+	 *	The history is invalid afterwards.
+	 */
+	void create_temporal_history_images(uint32_t aWidth, uint32_t aHeight)
+	{
+		using namespace avk;
+
+		for (auto& history : mTemporalHistory) {
+			context().main_window()->handle_lifetime(std::move(history));
+		}
+		mTemporalHistory.clear();
+
+		auto historyA = context().create_image(aWidth, aHeight, vk::Format::eR32G32Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto historyB = context().create_image(aWidth, aHeight, vk::Format::eR32G32Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto fen = context().record_and_submit_with_fence(command::gather(
+			sync::image_memory_barrier(historyA.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(historyB.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+		), *mQueue);
+		fen->wait_until_signalled();
+
+		mTemporalHistory.push_back(context().create_image_view(std::move(historyA)));
+		mTemporalHistory.push_back(context().create_image_view(std::move(historyB)));
+		mTemporalHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
+	}
+
+	/**	Returns the image which receives the occlusion factors in the given mode, i.e., a half resolution image or a transient image
+	 *	@param	aHalfResolution		Whether the occlusion factors are computed in half resolution
+	 *	@param	aHorizontallyBlurred	If true, the image which receives the intermediate results of the separable blur is returned
+	 */
+	avk::image_view& occlusion_factors(bool aHalfResolution, bool aHorizontallyBlurred = false)
+	{
+		if (aHalfResolution) {
+			return aHorizontallyBlurred ? mHalfResBlurredOcclusionFactors : mHalfResOcclusionFactors;
+		}
+		return mFrameGraph->transient_image(aHorizontallyBlurred ? "ssao horizontally blurred occlusion factors" : "ssao occlusion factors");
+	}
+
+	/** Declares that the given pass reads the occlusion factors (or the intermediate results of the separable blur) in the given mode */
+	void reads_occlusion_factors(bool aHalfResolution, frame_graph::pass& aPass, frame_graph::stage_flags aStages, frame_graph::access_flags aAccess, bool aHorizontallyBlurred = false)
+	{
+		if (aHalfResolution) {
+			aPass.reads(occlusion_factors(true, aHorizontallyBlurred), aStages, aAccess);
+		}
+		else {
+			aPass.reads_transient(aHorizontallyBlurred ? "ssao horizontally blurred occlusion factors" : "ssao occlusion factors", aStages, aAccess);
+		}
+	}
+
+	/** Declares that the given pass writes the occlusion factors (or the intermediate results of the separable blur) in the given mode */
+	void writes_occlusion_factors(bool aHalfResolution, frame_graph::pass& aPass, frame_graph::stage_flags aStages, frame_graph::access_flags aAccess, bool aHorizontallyBlurred = false)
+	{
+		if (aHalfResolution) {
+			aPass.writes(occlusion_factors(true, aHorizontallyBlurred), aStages, aAccess);
+		}
+		else {
+			aPass.writes_transient(aHorizontallyBlurred ? "ssao horizontally blurred occlusion factors" : "ssao occlusion factors", aStages, aAccess);
+		}
+	}
+
 	/** One single queue to submit all the commands to: */
 	avk::queue* mQueue;
 
 	/** One descriptor cache to use for allocating all the descriptor sets from: */
 	avk::descriptor_cache mDescriptorCache;
 
-	/** A command pool for allocating (single-use) command buffers from: */
-	avk::command_pool mCommandPool;
+	/** The frame graph which all passes are added to: */
+	frame_graph* mFrameGraph;
 
 	// Settings, which can be modified via ImGui:
 	bool mSsaoEnabled = true;
+	bool mAsyncCompute = false;
+	bool mHalfResolution = false;
+	float mUpsampleDepthSharpness = 50.0f;
+	// 0 ... hemisphere sampling (SSAO), 1 ... horizon-based (GTAO)
+	int mAlgorithm = 0;
+	float mAlgorithmDurations[2] = { 0.0f, 0.0f };
+	int mGtaoNumDirections = 2;
+	int mGtaoNumSteps = 4;
+	bool mTemporal = false;
+	int mTemporalNumSamples = 6;
+	float mTemporalAlpha = 0.1f;
+	float mTemporalDepthTolerance = 0.05f;
 	int mNumSamples = 32;
 	float mSampleRadius = 2.0f;
 	float mDarkeningFactor = 1.5;
@@ -374,20 +679,30 @@ private:
 	int mBlurOcclusionFactors = 0;
 	float mIntensity = 1.0f;
 	float mSpatial = 1.0f;
-
-	int mPingPong{ 1 };
+	// Half the size of the blur kernels (a specialization constant of the separable blur, hence, not modifiable at runtime):
+	int mBlurKernelSize = 5;
 
 	// Source image views:
 	avk::image_view mSrcDepth;
 	avk::image_view mSrcUvNrm;
 	avk::image_view mSrcColor;
 
+	// Downsampled depth and normals, and the occlusion factors, which are used in half resolution mode:
+	avk::image_view mHalfResDepth;
+	avk::image_view mHalfResUvNrm;
+	avk::image_view mHalfResOcclusionFactors;
+	avk::image_view mHalfResBlurredOcclusionFactors;
+
+	// Accumulated occlusion factors (.r) and linear depth values (.g) of the temporal mode, used alternately:
+	std::vector<avk::image_view> mTemporalHistory;
+	// The frame which has written the history last, and its view projection matrix:
+	avk::window::frame_id_t mTemporalHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
+	glm::mat4 mTemporalHistoryViewProjMatrix{ 1.0f };
+
 	// Destination image view:
 	avk::image_view mDstResults;
-	// Images for intermediate results:
-	avk::image_view mIntermediateImage;
-	// Buffer containing the user input and matrices:
-	avk::buffer mUniformsBuffer;
+	// Buffers containing the user input and matrices, one per frame in flight:
+	std::vector<avk::buffer> mUniformsBuffers;
 
 	// Random samples which are used by SSAO:
 	avk::buffer mRandomSamplesBuffer;
@@ -397,13 +712,28 @@ private:
 	avk::compute_pipeline mOcclusionFactorsPipeline;
 	// Push constants used in the mOcclusionFactorsPipeline:
 	push_constants_for_ssao mOcclusionFactorsPushConstants;
+	// The horizon-based alternative to mOcclusionFactorsPipeline, and its push constants:
+	avk::compute_pipeline mGtaoPipeline;
+	push_constants_for_gtao mGtaoPushConstants;
+	// Pipeline which blends the occlusion factors with the history in temporal mode, and its push constants:
+	avk::compute_pipeline mTemporalAccumulationPipeline;
+	push_constants_for_temporal_accumulation mTemporalPushConstants;
 	// Push constants used in the mBlurOcclusionFactorsPipeline:
 	push_constants_for_blur mBlurPushConstants;
 
 	avk::compute_pipeline mBlurOcclusionFactorsPipeline;
 
+	// Pipeline which blurs the occlusion factors in two separable passes, and its push constants:
+	avk::compute_pipeline mSeparableBlurOcclusionFactorsPipeline;
+	push_constants_for_separable_blur mSeparableBlurPushConstants;
+
+	// Pipeline which downsamples depth and normals for the half resolution mode:
+	avk::compute_pipeline mDownsampleDepthNormalsPipeline;
+
 	// Pipeline which applies the occlusion factors to the source color image
 	avk::compute_pipeline mApplyOcclusionFactorsPipeline;
+	// Push constants used in the mApplyOcclusionFactorsPipeline:
+	push_constants_for_apply mApplyPushConstants;
 
 };
 
@@ -1,9 +1,11 @@
 #include "imgui_utils.h"
+#include "frame_graph.hpp"
 #include "ambient_occlusion.hpp"
 #include "reflections.hpp"
 #include "tone_mapping.hpp"
 #include "anti_aliasing.hpp"
 #include "transfer_to_swapchain.hpp"
+#include "../shaders/light_clusters.h"
 #include <conversion_utils.hpp>
 
 // TODO Bonus Tasks RTX ON Path: Uncomment the following line to turn RTX ON
@@ -42,6 +44,19 @@ class assignment4 : public avk::invokee
 	};
 #endif
 
+	/** Secondary command buffers of the scene pass which are recorded once and replayed in subsequent frames,
+	 *	together with the state they have been recorded for.
+	 */
+	struct cached_scene_pass
+	{
+		std::vector<avk::command_buffer> mDepthPrePassCommandBuffers;
+		std::vector<avk::command_buffer> mGBufferPassCommandBuffers;
+		// Settings these command buffers have been recorded with (wireframe, depth pre-pass, parallel recording):
+		std::tuple<bool, bool, bool, bool> mSceneState;
+		// Set whenever pipelines or the framebuffer have been recreated, s.t. the command buffers must be re-recorded:
+		bool mOutdated = true;
+	};
+
 	/** Struct definition for push constants used for the draw calls of the scene */
 	struct push_constants_for_draw
 	{
@@ -62,28 +77,43 @@ class assignment4 : public avk::invokee
 		glm::mat4 mCamPos;
 		// x = tessellation factor, y = displacement strength, z = enable PN-triangles, w unused
 		glm::vec4 mUserInput;
+		// x = near plane distance, y = far plane distance, z = light cutoff intensity, w = point and spot lights: 0 = all, 1 = clustered, 2 = light volumes, 3 = stochastic
+		glm::vec4 mClusteringParams;
+		// Transforms from view space into the previous frame's clip space (for temporal accumulation of the stochastic lighting)
+		glm::mat4 mViewToHistoryClipMatrix;
+		// x = light samples per pixel, y = candidates per light sample, z = temporal blend factor (1 = no history), w = frame index (random seed)
+		glm::vec4 mStochasticLightsParams;
+		// Projection matrix without the jitter of temporal anti-aliasing
+		glm::mat4 mUnjitteredProjMatrix;
+		// Transforms from view space into the previous frame's unjittered clip space (for the velocity G-Buffer target)
+		glm::mat4 mViewToPrevClipMatrix;
 	};
 
-	/** Struct definition for data used as UBO across different pipelines, containing lightsource data */
-	struct lightsource_data
+	/** Struct definition for the storage buffer which the light culling compute shader writes the light clusters into */
+	struct light_clusters_data
 	{
-		// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
-		glm::uvec4 mRangesAmbientDirectional;
-		// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
-		glm::uvec4 mRangesPointSpot;
-		// Contains all the data of all the active light sources
-		std::array<avk::lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES> mLightData;
+		// Number of entries of mLightIndices which have been allocated by the clusters (reset to 0 before the light culling)
+		uint32_t mNumLightIndices;
+		uint32_t mPadding;
+		// For each cluster: x ... offset into mLightIndices, y ... number of point and spot light sources affecting it
+		std::array<glm::uvec2, NUMBER_OF_LIGHT_CLUSTERS> mClusters;
+		// Indices of the light sources, compactly stored one cluster after the other
+		std::array<uint32_t, LIGHT_CLUSTER_INDEX_CAPACITY> mLightIndices;
 	};
 
 	// ----------------------------------------------------
 
 public:
 	/** Constructor
-	 *	@param	aQueue	Stores an avk::queue* internally for future use, which has been created previously.
+	 *	@param	aQueue				Stores an avk::queue* internally for future use, which has been created previously.
+	 *	@param	aAsyncComputeQueue	A second queue, which the post processing passes can be executed on asynchronously.
 	 */
-	assignment4(avk::queue& aQueue)
+	assignment4(avk::queue& aQueue, avk::queue& aAsyncComputeQueue)
 		: mQueue{ &aQueue }
+		, mAsyncComputeQueue{ &aAsyncComputeQueue }
 		, mSkyboxSphere{ &aQueue }
+		, mLightVolumeSphere{ &aQueue }
+		, mLightVolumeCone{ &aQueue }
 	{
 	}
 
@@ -102,6 +132,12 @@ public:
 
 		// Create a command pool for allocating single-use (hence, transient) command buffers:
 		mCommandPool = context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient);
+
+		// Create one additional command pool per recording thread for the secondary command buffers of the scene pass:
+		const auto numRecordingThreads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+		for (uint32_t i = 0; i < numRecordingThreads; ++i) {
+			mSecondaryCommandPools.push_back(context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient));
+		}
 		
 		// Load 3D scenes/models from files:
 		std::vector<helpers::data_for_draw_call> dataForDrawCalls;
@@ -116,6 +152,13 @@ public:
 
 		std::vector<recorded_commands_t> commandsToBeExcecuted;
 
+		// Only terrain and debris are tessellated. Move all the other draw calls to the front, so that they can be rendered
+		// with a plain vertex/fragment pipeline, and the tessellation pipeline only has to be bound once for the remaining ones:
+		auto firstTessellated = std::stable_partition(std::begin(dataForDrawCalls), std::end(dataForDrawCalls), [](const helpers::data_for_draw_call& data) {
+			return !helpers::is_to_be_tessellated(data.mModelName);
+		});
+		mNumNonTessellatedDrawCalls = static_cast<size_t>(std::distance(std::begin(dataForDrawCalls), firstTessellated));
+
 		// helpers::load_models_and_scenes_from_file returned only the raw vertex data.
 		//  => Put them all into buffers which we can use during rendering:
 		for (auto& data : dataForDrawCalls) {
@@ -251,16 +294,41 @@ public:
 
 		// Create helper geometry for the skybox:
 		mSkyboxSphere.create_sphere();
+		// Create the light volumes. Their vertices lie on the unit sphere/cone => scale them up a bit, s.t. their faces enclose it:
+		const float enclose = 1.0f / glm::cos(glm::pi<float>() / 20.0f);
+		mLightVolumeSphere.create_sphere(10, 20, glm::scale(glm::vec3{ enclose * enclose }));
+		mLightVolumeCone.create_cone(20, true, glm::scale(glm::vec3{ enclose, 1.0f, enclose }));
 		
-		mUniformsBuffer = context().create_buffer(
-			memory_usage::host_coherent, {}, // Create its backing memory in a host coherent memory region (writable from the host-side)
-			uniform_buffer_meta::create_from_size(sizeof(matrices_and_user_input)) // Meta data tells the type of this buffer => A uniform buffer
-		);
-		mLightsBuffer = context().create_buffer(
-			memory_usage::device, {}, // Create its backing memory in a device-only memory region (takes an additional intermediate step
-									  // to be filled (internally handled) through a host visible buffer, but faster access during rendering.)
-			uniform_buffer_meta::create_from_size(sizeof(lightsource_data)) // Meta data tells the type of this buffer => A uniform buffer
-		);
+		// Create GPU buffers which will be populated with frame-specific user data (matrices, settings), and lightsource data.
+		// Since multiple frames can be in flight concurrently, we need one of each per frame in flight, i.e., they form a ring:
+		for (avk::window::frame_id_t i = 0; i < context().main_window()->number_of_frames_in_flight(); ++i) {
+			mUniformsBuffer.push_back(context().create_buffer(
+				memory_usage::host_coherent, {}, // Create its backing memory in a host coherent memory region (writable from the host-side)
+				uniform_buffer_meta::create_from_size(sizeof(matrices_and_user_input)) // Meta data tells the type of this buffer => A uniform buffer
+			));
+			// The lights are stored in storage buffers, which grow whenever there are more active light sources than they can hold.
+			// Also the lights are written directly from the host-side, without a staging copy:
+			mLightsBuffer.push_back(helpers::create_lights_buffer(memory_usage::host_coherent, helpers::get_lights().size()));
+			// Create its backing memory in a device-only memory region (takes an additional intermediate step to be filled (internally
+			// handled) through a host visible buffer, but faster access during rendering.)
+			mDeviceLocalLightsBuffer.push_back(helpers::create_lights_buffer(memory_usage::device, helpers::get_lights().size()));
+			mLightsBufferCapacity.push_back(helpers::get_lights().size());
+			mDeviceLocalLightsBufferCapacity.push_back(helpers::get_lights().size());
+			// Map the host coherent buffers once, and keep them mapped for as long as they exist:
+			mUniformsMappings.push_back(mUniformsBuffer.back()->map_memory(mapping_access::write));
+			mLightsMappings.push_back(mLightsBuffer.back()->map_memory(mapping_access::write));
+			mLightsRevisions.push_back(0); // => nothing written yet
+			mLightRangesPointSpot.emplace_back(0u);
+			mLightClustersBuffer.push_back(context().create_buffer(
+				memory_usage::device, { vk::BufferUsageFlagBits::eTransferDst }, // Only written on the device (the counter is reset with a fill command)
+				storage_buffer_meta::create_from_size(sizeof(light_clusters_data))
+			));
+			// The alias tables for the stochastic lighting are written from the host-side every frame, and grow like the lights buffers:
+			mLightAliasTableBuffer.push_back(context().create_buffer(memory_usage::host_coherent, {}, storage_buffer_meta::create_from_size(helpers::get_light_alias_table_size(helpers::get_lights().size()))));
+			mLightAliasTableCapacity.push_back(helpers::get_lights().size());
+			mLightAliasTableMappings.push_back(mLightAliasTableBuffer.back()->map_memory(mapping_access::write));
+			mCachedScenePasses.emplace_back();
+		}
 
 		// Initialize the cameras, and then add them to our composition (they are `avk::invokee`s too):
 		mOrbitCam.set_translation({ -6.81f, 1.71f, -0.72f });
@@ -280,7 +348,23 @@ public:
 		// Enable swapchain recreation and shader hot reloading:
 		enable_the_updater();
 
-		mAmbientOcclusion.config(*mQueue, mDescriptorCache,
+		// All command buffers of a frame are collected, and submitted at once by the submission batcher (also those of the lights editor and camera presets):
+		mSubmissionBatcher.config(*mQueue);
+		current_composition()->add_element(mSubmissionBatcher);
+		if (auto* lightsEditor = current_composition()->element_by_type<lights_editor>()) {
+			lightsEditor->set_submission_batcher(&mSubmissionBatcher);
+		}
+		if (auto* camPresets = current_composition()->element_by_type<camera_presets>()) {
+			camPresets->set_submission_batcher(&mSubmissionBatcher);
+		}
+
+		// All post processing effects add their passes to the frame graph, which records them into one command buffer:
+		// Each effect can let its passes be executed on the async compute queue (see the "async compute" checkboxes):
+		mFrameGraph.config(*mQueue, mSubmissionBatcher);
+		mFrameGraph.config_async_compute(*mAsyncComputeQueue);
+		current_composition()->add_element(mFrameGraph);
+
+		mAmbientOcclusion.config(*mQueue, mDescriptorCache, mFrameGraph,
 			mUniformsBuffer,
 			mFramebuffer->image_views()[0],
 			mFramebuffer->image_views()[1],
@@ -289,7 +373,7 @@ public:
 		);
 		current_composition()->add_element(mAmbientOcclusion);
 
-		mReflections.config(*mQueue, mDescriptorCache,
+		mReflections.config(*mQueue, mDescriptorCache, mFrameGraph,
 			mUniformsBuffer,
 			mStorageImageViewsHdr[0], // <-- Source colors for reflections shall have ambient occlusion already applied
 			mFramebuffer->image_views()[1],
@@ -307,22 +391,23 @@ public:
 #endif
 		current_composition()->add_element(mReflections);
 
-		mToneMapping.config(*mQueue, mDescriptorCache,
+		mToneMapping.config(*mQueue, mDescriptorCache, mFrameGraph,
 			mStorageImageViewsHdr[1],  // <-- HDR input
 			mStorageImageViewsLdr[0]   // <-- Destination
 		);
 		current_composition()->add_element(mToneMapping);
 
-		mAntiAliasing.config(*mQueue, mDescriptorCache,
+		mAntiAliasing.config(*mQueue, mDescriptorCache, mFrameGraph,
 			mUniformsBuffer,
 			mStorageImageViewsLdr[0],		// <-- Source
 			mFramebuffer->image_views()[1],	// <-- Depth
+			mFramebuffer->image_views()[4],	// <-- Velocity
 			mStorageImageViewsLdr[1]		// <-- Destination
 		);
 		current_composition()->add_element(mAntiAliasing);
 
 		// Transfer the latest destination image into the swapchain image:
-		mTransferToSwapchain.config(*mQueue,
+		mTransferToSwapchain.config(*mQueue, mSubmissionBatcher,
 			mFramebuffer->image_views()[1], transfer_to_swapchain::transfer_type::copy, layout::shader_read_only_optimal >> layout::shader_read_only_optimal,
 			mStorageImageViewsLdr[1]      , transfer_to_swapchain::transfer_type::copy, layout::general >> layout::general,
 			// By passing the (optional) intermediate image, instead of copying/blitting directly into the swap chain images, we perform:
@@ -335,8 +420,8 @@ public:
 		current_composition()->add_element(mTransferToSwapchain);
 	}
 
-	/** TODO:	Helper function, which creates a renderpass with three sub passes, and
-	 *	three graphics pipelines---one for each of the renderpass' sub passes.
+	/** TODO:	Helper function, which creates a renderpass with four sub passes (the first one being
+	 *	an optional depth pre-pass), and the graphics pipelines for each of the renderpass' sub passes.
 	 *
 	 */
 	void init_pipelines()
@@ -350,7 +435,8 @@ public:
 			vk::Format::eR16G16B16A16Sfloat,
 			vk::Format::eD32Sfloat,
 			vk::Format::eR32G32B32A32Sfloat,
-			vk::Format::eR16G16B16A16Uint
+			vk::Format::eR16G16B16A16Uint,
+			vk::Format::eR16G16Sfloat
 			);
 		constexpr auto storageFormat = attachmentFormats[0];
 
@@ -358,6 +444,7 @@ public:
 		auto depthAttachment = context().create_image(resolution.x, resolution.y, attachmentFormats[1], 1, memory_usage::device, image_usage::depth_stencil_attachment | image_usage::input_attachment | image_usage::sampled | image_usage::tiling_optimal | image_usage::transfer_source);
 		auto uvNrmAttachment = context().create_image(resolution.x, resolution.y, attachmentFormats[2], 1, memory_usage::device, image_usage::color_attachment | image_usage::input_attachment | image_usage::sampled | image_usage::tiling_optimal);
 		auto matIdAttachment = context().create_image(resolution.x, resolution.y, attachmentFormats[3], 1, memory_usage::device, image_usage::color_attachment | image_usage::input_attachment | image_usage::sampled | image_usage::tiling_optimal);
+		auto velocityAttachment = context().create_image(resolution.x, resolution.y, attachmentFormats[4], 1, memory_usage::device, image_usage::color_attachment | image_usage::sampled | image_usage::tiling_optimal);
 
 		// Note: sRGB formats are, unfortunately, not supported for storage images on many GPUs.
 		auto storageImagesHdr = avk::make_array<avk::image>(
@@ -376,6 +463,7 @@ public:
 				sync::image_memory_barrier(depthAttachment.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::shader_read_only_optimal),
 				sync::image_memory_barrier(uvNrmAttachment.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::shader_read_only_optimal),
 				sync::image_memory_barrier(matIdAttachment.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::shader_read_only_optimal),
+				sync::image_memory_barrier(velocityAttachment.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::shader_read_only_optimal),
 				// Transition the storage image into GENERAL layout and keep it in that layout forever:
 				sync::image_memory_barrier(storageImagesHdr[0].as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
 				sync::image_memory_barrier(storageImagesHdr[1].as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
@@ -392,6 +480,7 @@ public:
 		auto depthAttachmentView = context().create_image_view(std::move(depthAttachment));
 		auto uvNrmAttachmentView = context().create_image_view(std::move(uvNrmAttachment));
 		auto matIdAttachmentView = context().create_image_view(std::move(matIdAttachment));
+		auto velocityAttachmentView = context().create_image_view(std::move(velocityAttachment));
 
 		assert(mStorageImageViewsHdr.size() == storageImagesHdr.size());
 		for (int i = 0; i < mStorageImageViewsHdr.size(); ++i) {
@@ -407,30 +496,52 @@ public:
 		//  - Which kinds of attachments are used and for how many sub passes
 		//  - What dependencies are necessary between sub passes, to achieve correct rendering results
 		auto renderpass = context().create_renderpass(
-			{ // We have THREE sub passes here!   vvv    To properly set this up, we need to define for every attachment, how it is used in each single one of these THREE sub passes    vvv
-				attachment::declare(attachmentFormats[0], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::unused        >> usage::color(0) >> usage::color(0)      , on_store::store.in_layout(layout::shader_read_only_optimal)),
-				attachment::declare(attachmentFormats[1], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::depth_stencil >> usage::input(0) >> usage::depth_stencil , on_store::store.in_layout(layout::shader_read_only_optimal)),
-				attachment::declare(attachmentFormats[2], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::color(0)      >> usage::input(1) >> usage::preserve      , on_store::store.in_layout(layout::shader_read_only_optimal)),
-				attachment::declare(attachmentFormats[3], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::color(1)      >> usage::input(2) >> usage::preserve      , on_store::store.in_layout(layout::shader_read_only_optimal)),
+			{ // We have FOUR sub passes here!   vvv    To properly set this up, we need to define for every attachment, how it is used in each single one of these FOUR sub passes    vvv
+			  // The FIRST sub pass is the (optional) depth pre-pass, which only writes depth. If it is disabled, it remains empty.
+			  // In the THIRD sub pass, the depth attachment is read-only: it is read as input attachment and tested against by the light volumes at the same time.
+				attachment::declare(attachmentFormats[0], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::unused        >> usage::unused        >> usage::color(0) >> usage::color(0)      , on_store::store.in_layout(layout::shader_read_only_optimal)),
+				attachment::declare(attachmentFormats[1], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::depth_stencil >> usage::depth_stencil >> usage::input(0) + usage::depth_stencil >> usage::depth_stencil , on_store::store.in_layout(layout::shader_read_only_optimal)),
+				attachment::declare(attachmentFormats[2], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::unused        >> usage::color(0)      >> usage::input(1) >> usage::preserve      , on_store::store.in_layout(layout::shader_read_only_optimal)),
+				attachment::declare(attachmentFormats[3], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::unused        >> usage::color(1)      >> usage::input(2) >> usage::preserve      , on_store::store.in_layout(layout::shader_read_only_optimal)),
+				// The velocity target is only written in the G-Buffer pass (the sky keeps the cleared zero velocity), and read by temporal anti-aliasing.
+				// The previous frame's TAA (a compute shader) might still read it when it is cleared => see the dependency into the SECOND sub pass:
+				attachment::declare(attachmentFormats[4], on_load::clear.from_previous_layout(layout::shader_read_only_optimal), usage::unused        >> usage::color(2)      >> usage::preserve >> usage::preserve      , on_store::store.in_layout(layout::shader_read_only_optimal)),
 			},
-			{ // Describe the dependencies between external commands and the FIRST sub pass:
-                subpass_dependency( subpass::external                >>   subpass::index(0),
-					    			stage::color_attachment_output   >>  stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output,
-									access::none                     >>  access::depth_stencil_attachment_read | access::depth_stencil_attachment_write | access::color_attachment_write
+			{ // Describe the dependencies between external commands and the sub passes in which the attachments are used first:
+				// With multiple frames in flight, the previous frame's post processing (compute and transfer) might still read from the
+				// attachments => their clears and layout transitions must wait for it. Every attachment is covered by the dependency
+				// of the sub pass it is used in first: the depth attachment by the FIRST, the G-Buffer attachments (including the
+				// velocity target, which temporal anti-aliasing reads) by the SECOND, and the color attachment by the THIRD one:
+                subpass_dependency( subpass::external                                                     >>   subpass::index(0),
+					    			stage::color_attachment_output | stage::compute_shader | stage::transfer  >>  stage::early_fragment_tests | stage::late_fragment_tests,
+									access::none                                                              >>  access::depth_stencil_attachment_read | access::depth_stencil_attachment_write
 								  ),
-				// Describe the dependencies between the FIRST and the SECOND sub pass:
-				subpass_dependency( subpass::index(0)                                                                          >>   subpass::index(1),
-					    			stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output  >>  stage::fragment_shader,
-									access::depth_stencil_attachment_write | access::color_attachment_write                    >>  access::input_attachment_read
+                subpass_dependency( subpass::external                                                     >>   subpass::index(1),
+					    			stage::color_attachment_output | stage::compute_shader | stage::transfer  >>  stage::color_attachment_output,
+									access::none                                                              >>  access::color_attachment_write
+								  ),
+                subpass_dependency( subpass::external                                                     >>   subpass::index(2),
+					    			stage::color_attachment_output | stage::compute_shader | stage::transfer  >>  stage::color_attachment_output,
+									access::none                                                              >>  access::color_attachment_write
+								  ),
+				// Describe the dependencies between the FIRST (depth pre-pass) and the SECOND sub pass:
+				subpass_dependency( subpass::index(0)                                          >>   subpass::index(1),
+					    			stage::early_fragment_tests | stage::late_fragment_tests   >>  stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output,
+									access::depth_stencil_attachment_write                     >>  access::depth_stencil_attachment_read | access::depth_stencil_attachment_write | access::color_attachment_write
 								  ),
 				// Describe the dependencies between the SECOND and the THIRD sub pass:
-				subpass_dependency( subpass::index(1)               >>  subpass::index(2),
+				subpass_dependency( subpass::index(1)                                                                          >>   subpass::index(2),
+					    			stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output  >>  stage::fragment_shader | stage::early_fragment_tests | stage::late_fragment_tests,
+									access::depth_stencil_attachment_write | access::color_attachment_write                    >>  access::input_attachment_read | access::depth_stencil_attachment_read
+								  ),
+				// Describe the dependencies between the THIRD and the FOURTH sub pass:
+				subpass_dependency( subpass::index(2)               >>  subpass::index(3),
 									stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output  >>  stage::early_fragment_tests | stage::late_fragment_tests | stage::color_attachment_output,
 									access::depth_stencil_attachment_write | access::color_attachment_write                    >>  access::depth_stencil_attachment_read | access::depth_stencil_attachment_write | access::color_attachment_write
-									// Note: Although this might seem unintuitive, we have to synchronize with read AND write access to the depth/stencil attachment here  ^^^  This is due to the image layout transition (input attachment optimal >> depth/stencil attachment optimal)
+									// Note: Although this might seem unintuitive, we have to synchronize with read AND write access to the depth/stencil attachment here  ^^^  This is due to the image layout transition (depth/stencil read-only optimal >> depth/stencil attachment optimal)
 								  ),
-				// Describe the dependencies between the THIRD sub pass and external commands:
-				subpass_dependency( subpass::index(2)               >>  subpass::external,
+				// Describe the dependencies between the FOURTH sub pass and external commands:
+				subpass_dependency( subpass::index(3)               >>  subpass::external,
 									// Commands after this renderpass will be either compute shaders or copy/blit commands => sync with them here:
 									stage::color_attachment_output | stage::late_fragment_tests              >>  stage::compute_shader | stage::transfer,
 									access::color_attachment_write | access::depth_stencil_attachment_write  >>  access::shader_read   | access::transfer_read
@@ -449,9 +560,14 @@ public:
 				, depthAttachmentView // means that they can be used at other places, too, and 
 				, uvNrmAttachmentView // will lead them being stored in shared_ptrs internally.
 				, matIdAttachmentView
+				, velocityAttachmentView
 			)
 		);
 		
+		// The stochastic lighting is accumulated with the previous frame's result, which is sampled from these history images:
+		mLightingHistorySampler = context().create_sampler(filter_mode::bilinear, border_handling_mode::clamp_to_edge, 0);
+		create_lighting_history_images();
+
 		// Create a graphics pipeline consisting of a vertex shader and a fragment shader, plus additional config:
 		mGBufferPassPipeline = context().create_graphics_pipeline_for(
 			vertex_shader("shaders/transform_and_pass_on.vert"),
@@ -465,8 +581,8 @@ public:
 			from_buffer_binding(3)->stream_per_vertex<glm::vec3>()->to_location(3), // Stream tangents from the vertex buffer bound at index #3
 			from_buffer_binding(4)->stream_per_vertex<glm::vec3>()->to_location(4), // Stream bitangents from the vertex buffer bound at index #4
 
-			// Use the renderpass created above, and specify that we're intending to use this pipeline for its first subpass:
-			renderpass, cfg::subpass_index{ 0u },
+			// Use the renderpass created above, and specify that we're intending to use this pipeline for its second subpass:
+			renderpass, cfg::subpass_index{ 1u },
 
 			// Configuration parameters for this graphics pipeline:
 			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
@@ -481,14 +597,117 @@ public:
 			push_constant_binding_data{ shader_type::vertex | shader_type::fragment | shader_type::tessellation_control | shader_type::tessellation_evaluation, 0, sizeof(push_constants_for_draw) },
 			descriptor_binding(0, 0, mMaterials),
 			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
-			descriptor_binding(1, 0, mUniformsBuffer),
-			descriptor_binding(1, 1, mLightsBuffer)
+			descriptor_binding(1, 0, mUniformsBuffer[0]), // Doesn't have to be the exact buffer, but one that describes the correct layout for the pipeline.
+			descriptor_binding(1, 1, mLightsBuffer[0])
 		);
 
 		// Create an (almost identical) pipeline to render the scene in wireframe mode
 		mGBufferPassWireframePipeline = context().create_graphics_pipeline_from_template(mGBufferPassPipeline.as_reference(), [](graphics_pipeline_t& p) {
 			p.rasterization_state_create_info().setPolygonMode(vk::PolygonMode::eLine);
 		});
+
+		// Create a graphics pipeline without tessellation stages for all the meshes which are not to be tessellated anyways.
+		// Its push constants and descriptors are identical to mGBufferPassPipeline's, so that bound descriptor sets remain valid:
+		mGBufferPassNoTessPipeline = context().create_graphics_pipeline_for(
+			vertex_shader("shaders/transform_and_pass_on.vert"),
+			fragment_shader("shaders/blinnphong_and_normal_mapping.frag"),
+
+			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // Stream positions from the vertex buffer bound at index #0
+			from_buffer_binding(1)->stream_per_vertex<glm::vec2>()->to_location(1), // Stream texture coordinates from the vertex buffer bound at index #1
+			from_buffer_binding(2)->stream_per_vertex<glm::vec3>()->to_location(2), // Stream normals from the vertex buffer bound at index #2
+			from_buffer_binding(3)->stream_per_vertex<glm::vec3>()->to_location(3), // Stream tangents from the vertex buffer bound at index #3
+			from_buffer_binding(4)->stream_per_vertex<glm::vec3>()->to_location(4), // Stream bitangents from the vertex buffer bound at index #4
+
+			// Same renderpass and subpass as mGBufferPassPipeline:
+			renderpass, cfg::subpass_index{ 1u },
+
+			// Configuration parameters for this graphics pipeline:
+			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
+			cfg::viewport_depth_scissors_config::from_framebuffer(
+				context().main_window()->backbuffer_reference_at_index(0) // Just use any compatible framebuffer here
+			),
+
+			cfg::primitive_topology::triangles,
+
+			// Define push constants and resource descriptors which are to be used with this draw call:
+			push_constant_binding_data{ shader_type::vertex | shader_type::fragment | shader_type::tessellation_control | shader_type::tessellation_evaluation, 0, sizeof(push_constants_for_draw) },
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+			descriptor_binding(1, 0, mUniformsBuffer[0]),
+			descriptor_binding(1, 1, mLightsBuffer[0])
+		);
+
+		// ...and its wireframe counterpart:
+		mGBufferPassNoTessWireframePipeline = context().create_graphics_pipeline_from_template(mGBufferPassNoTessPipeline.as_reference(), [](graphics_pipeline_t& p) {
+			p.rasterization_state_create_info().setPolygonMode(vk::PolygonMode::eLine);
+		});
+
+		// If the depth pre-pass has been performed, the G-Buffer pass only has to shade the visible fragments.
+		// It tests for depth EQUAL and doesn't write depth. (Both shader sets declare gl_Position as invariant for that.)
+		mGBufferPassAfterPrePassPipeline = context().create_graphics_pipeline_from_template(mGBufferPassPipeline.as_reference(), [](graphics_pipeline_t& p) {
+			p.depth_stencil_config().setDepthCompareOp(vk::CompareOp::eEqual).setDepthWriteEnable(VK_FALSE);
+		});
+		mGBufferPassNoTessAfterPrePassPipeline = context().create_graphics_pipeline_from_template(mGBufferPassNoTessPipeline.as_reference(), [](graphics_pipeline_t& p) {
+			p.depth_stencil_config().setDepthCompareOp(vk::CompareOp::eEqual).setDepthWriteEnable(VK_FALSE);
+		});
+
+		// Create the depth-only pipeline for the tessellated meshes of the pre-pass. It uses the very same tessellation
+		// stages as mGBufferPassPipeline, so that the displaced depth values match exactly. No fragment shader is required:
+		mDepthPrePassPipeline = context().create_graphics_pipeline_for(
+			vertex_shader("shaders/transform_and_pass_on.vert"),
+			tessellation_control_shader("shaders/tess_pn_controlpoints.tesc"),
+			tessellation_evaluation_shader("shaders/tess_pn_interp_and_displacement.tese"),
+
+			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // Stream positions from the vertex buffer bound at index #0
+			from_buffer_binding(1)->stream_per_vertex<glm::vec2>()->to_location(1), // Stream texture coordinates from the vertex buffer bound at index #1
+			from_buffer_binding(2)->stream_per_vertex<glm::vec3>()->to_location(2), // Stream normals from the vertex buffer bound at index #2
+			from_buffer_binding(3)->stream_per_vertex<glm::vec3>()->to_location(3), // Stream tangents from the vertex buffer bound at index #3
+			from_buffer_binding(4)->stream_per_vertex<glm::vec3>()->to_location(4), // Stream bitangents from the vertex buffer bound at index #4
+
+			// Use the renderpass created above, and specify that we're intending to use this pipeline for its FIRST subpass:
+			renderpass, cfg::subpass_index{ 0u },
+
+			// Configuration parameters for this graphics pipeline:
+			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
+			cfg::viewport_depth_scissors_config::from_framebuffer(
+				context().main_window()->backbuffer_reference_at_index(0) // Just use any compatible framebuffer here
+			),
+
+			cfg::primitive_topology::patches,
+			cfg::tessellation_patch_control_points{ 3u },
+
+			// Define push constants and resource descriptors which are to be used with this draw call:
+			push_constant_binding_data{ shader_type::vertex | shader_type::fragment | shader_type::tessellation_control | shader_type::tessellation_evaluation, 0, sizeof(push_constants_for_draw) },
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+			descriptor_binding(1, 0, mUniformsBuffer[0]),
+			descriptor_binding(1, 1, mLightsBuffer[0])
+		);
+
+		// Create the depth-only pipeline for all the other meshes of the pre-pass, which only streams positions:
+		mDepthPrePassNoTessPipeline = context().create_graphics_pipeline_for(
+			vertex_shader("shaders/depth_only.vert"),
+
+			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // Stream positions from the vertex buffer bound at index #0
+
+			// Use the renderpass created above, and specify that we're intending to use this pipeline for its FIRST subpass:
+			renderpass, cfg::subpass_index{ 0u },
+
+			// Configuration parameters for this graphics pipeline:
+			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
+			cfg::viewport_depth_scissors_config::from_framebuffer(
+				context().main_window()->backbuffer_reference_at_index(0) // Just use any compatible framebuffer here
+			),
+
+			cfg::primitive_topology::triangles,
+
+			// Define push constants and resource descriptors which are to be used with this draw call:
+			push_constant_binding_data{ shader_type::vertex | shader_type::fragment | shader_type::tessellation_control | shader_type::tessellation_evaluation, 0, sizeof(push_constants_for_draw) },
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+			descriptor_binding(1, 0, mUniformsBuffer[0]),
+			descriptor_binding(1, 1, mLightsBuffer[0])
+		);
 		
 		// Create the graphics pipeline to be used for drawing the lit scene:
 		mLightingPassGraphicsPipeline = context().create_graphics_pipeline_for(
@@ -496,8 +715,8 @@ public:
 			vertex_shader("shaders/lighting_pass.vert"),
 			fragment_shader("shaders/lighting_pass.frag"),
 
-			// Use the renderpass created above, and specify that we're intending to use this pipeline for its SECOND subpass:
-			renderpass, cfg::subpass_index{ 1u },
+			// Use the renderpass created above, and specify that we're intending to use this pipeline for its THIRD subpass:
+			renderpass, cfg::subpass_index{ 2u },
 
 			// Configuration parameters for this graphics pipeline:
 			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
@@ -510,16 +729,51 @@ public:
 			push_constant_binding_data{ shader_type::vertex | shader_type::fragment | shader_type::tessellation_control | shader_type::tessellation_evaluation, 0, sizeof(push_constants_for_draw) },
 			descriptor_binding(0, 0, mMaterials),
 			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
-			descriptor_binding(1, 0, mUniformsBuffer),
-			descriptor_binding(1, 1, mLightsBuffer),
-			descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+			descriptor_binding(1, 0, mUniformsBuffer[0]),
+			descriptor_binding(1, 1, mLightsBuffer[0]),
+			descriptor_binding(1, 2, mLightClustersBuffer[0]),
+			descriptor_binding(1, 3, mLightAliasTableBuffer[0]),
+			descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::depth_stencil_read_only_optimal), shader_type::fragment),
 			descriptor_binding(2, 1, mFramebuffer->image_view_at(2)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
-			descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment)
+			descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+			descriptor_binding(2, 3, mLightingHistorySampler, shader_type::fragment),
+			descriptor_binding(2, 4, mLightingHistoryColor->as_sampled_image(layout::general), shader_type::fragment),
+			descriptor_binding(2, 5, mLightingHistoryDepth->as_sampled_image(layout::general), shader_type::fragment)
 #ifdef RTX_ON
 			, descriptor_binding(3, 0, mTopLevelAS)
 #endif
 		);
 
+		// Create the graphics pipeline which adds the contributions of the point and spot lights by drawing their volumes:
+		mLightVolumesPipeline = context().create_graphics_pipeline_for(
+			// Shaders to be used with this pipeline:
+			vertex_shader("shaders/light_volume.vert"),
+			fragment_shader("shaders/light_volume.frag"),
+			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // Stream positions from the vertex buffer bound at index #0
+
+			// It is used in the THIRD subpass, too, after the full-screen lighting pass:
+			renderpass, cfg::subpass_index{ 2u },
+
+			// Configuration parameters for this graphics pipeline:
+			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
+			cfg::culling_mode::cull_front_faces, // Draw the back faces, s.t. every pixel is shaded once, even if the camera is inside a volume
+			cfg::viewport_depth_scissors_config::from_framebuffer(
+				context().main_window()->backbuffer_reference_at_index(0) // Just use any compatible framebuffer here
+			),
+			// Only shade where the G-Buffer's surface lies in front of the volume's back face. The depth attachment is read-only in this subpass:
+			cfg::depth_test::enabled().set_compare_operation(cfg::compare_operation::greater_or_equal),
+			cfg::depth_write::disabled(),
+			cfg::color_blending_config::enable_additive_for_all_attachments(),
+
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+			descriptor_binding(1, 0, mUniformsBuffer[0]),
+			descriptor_binding(1, 1, mLightsBuffer[0]),
+			descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::depth_stencil_read_only_optimal), shader_type::fragment),
+			descriptor_binding(2, 1, mFramebuffer->image_view_at(2)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+			descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment)
+		);
+
 		// Create the graphics pipeline to be used for drawing the skybox:
 		mSkyboxPipeline = context().create_graphics_pipeline_for(
 			// Shaders to be used with this pipeline:
@@ -527,8 +781,8 @@ public:
 			fragment_shader("shaders/sky_gradient.frag"),
 			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // Stream positions from the vertex buffer bound at index #0
 
-			// Use the renderpass created above, and specify that we're intending to use this pipeline for its THIRD subpass:
-			renderpass, cfg::subpass_index{ 2u },
+			// Use the renderpass created above, and specify that we're intending to use this pipeline for its FOURTH subpass:
+			renderpass, cfg::subpass_index{ 3u },
 
 			// Configuration parameters for this graphics pipeline:
 			cfg::culling_mode::disabled,	// No backface culling required
@@ -539,7 +793,15 @@ public:
 				context().main_window()->backbuffer_reference_at_index(0) // Just use any compatible framebuffer here
 			),
 
-			descriptor_binding(0, 0, mUniformsBuffer)
+			descriptor_binding(0, 0, mUniformsBuffer[0])
+		);
+
+		// Create the compute pipeline which assigns the point and spot lights to the clusters used by the lighting pass:
+		mLightCullingPipeline = context().create_compute_pipeline_for(
+			"shaders/cluster_lights.comp",
+			descriptor_binding(0, 0, mUniformsBuffer[0]),
+			descriptor_binding(0, 1, mLightsBuffer[0]),
+			descriptor_binding(0, 2, mLightClustersBuffer[0])
 		);
 	}
 
@@ -596,6 +858,31 @@ public:
 			ImGui::Text("%.3f ms/Reflections", mReflections.duration());
 			ImGui::Text("%.3f ms/Tone Mapping", mToneMapping.duration());
 			ImGui::Text("%.3f ms/Anti Aliasing", mAntiAliasing.duration());
+			ImGui::Text("%.3f ms/G-Buffer and Lighting Pass", helpers::get_timing_interval_in_ms(std::format("scene pass {}", helpers::get_oldest_in_flight_index())));
+			ImGui::Text("%.3f ms/Lighting (%s)", helpers::get_timing_interval_in_ms(std::format("lighting {}", helpers::get_oldest_in_flight_index())),
+				mLightVolumes ? "light volumes" : mStochasticLights ? "stochastic" : mClusteredShading ? "clustered" : "full-screen");
+			if (mClusteredShading && !mLightVolumes && !mStochasticLights) {
+				ImGui::Text("%.3f ms/Light Culling", helpers::get_timing_interval_in_ms(std::format("light culling {}", helpers::get_oldest_in_flight_index())));
+			}
+			ImGui::Text("%.3f ms/Lights Upload (CPU)", mLightsUploadCpuTime);
+			ImGui::Text("%d lights uploaded", mNumLightsUploaded);
+			if (mDeviceLocalLights) {
+				ImGui::Text("%.3f ms/Lights Upload (GPU)", helpers::get_timing_interval_in_ms(std::format("lights upload {}", helpers::get_oldest_in_flight_index())));
+			}
+			ImGui::Text("Frame graph: %zu passes (%zu culled), %zu barriers", mFrameGraph.num_passes(), mFrameGraph.num_culled_passes(), mFrameGraph.num_barriers());
+			ImGui::Text("%zu transient images in %zu images", mFrameGraph.num_transient_images(), mFrameGraph.num_transient_image_allocations());
+			ImGui::Text("%zu command buffers in %zu submission(s) (+1 for the UI)", mSubmissionBatcher.num_command_buffers(), mSubmissionBatcher.num_submissions());
+			if (!mFrameGraph.has_async_compute_queue()) {
+				ImGui::Text("Async compute: no suitable queue");
+			}
+			else if (mFrameGraph.num_async_compute_passes() > 0) {
+				// The async passes of the oldest frame in flight overlap with the scene pass of the frame after it:
+				const auto oldest = helpers::get_oldest_in_flight_index();
+				const auto next = (oldest + 1) % context().main_window()->number_of_frames_in_flight();
+				ImGui::Text("Async compute: %zu passes in %zu submission(s)", mFrameGraph.num_async_compute_passes(), mFrameGraph.num_async_compute_submissions());
+				ImGui::Text("%.3f ms/Async Compute", helpers::get_timing_interval_in_ms(std::format("async compute {}", oldest)));
+				ImGui::Text("%.3f ms overlap with the next scene pass", helpers::get_timing_intervals_overlap_in_ms(std::format("async compute {}", oldest), std::format("scene pass {}", next)));
+			}
 			
 			static std::vector<float> accum; // accumulate (then average) 10 frames
 			accum.push_back(ImGui::GetIO().Framerate);
@@ -637,6 +924,33 @@ public:
 
 			ImGui::SetNextItemWidth(100);
 			ImGui::InputInt("Max point lights", &mLimitNumPointlights, 0, 0);
+			ImGui::Checkbox("Light Volumes", &mLightVolumes);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Add the point and spot lights by drawing their volumes (instanced spheres and cones),\ninstead of evaluating them for every pixel in the full-screen lighting pass.");
+			}
+			ImGui::Checkbox("Stochastic Lights", &mStochasticLights);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Only evaluate a fixed number of point and spot lights per pixel, which are sampled by their power (and distance),\nand accumulate the results over time. The cost per pixel does not depend on the number of lights.");
+			}
+			if (mStochasticLights) {
+				ImGui::PushItemWidth(100);
+				ImGui::SliderInt("Light samples/pixel", &mStochasticLightSamples, 1, 16);
+				ImGui::SliderInt("Candidates/sample", &mStochasticLightCandidates, 1, 32);
+				ImGui::SliderFloat("Temporal blend factor", &mStochasticLightsAlpha, 0.01f, 1.0f);
+				ImGui::PopItemWidth();
+			}
+			ImGui::Checkbox("Clustered Shading", &mClusteredShading);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Assign the point and spot lights to a %dx%dx%d grid of clusters in a compute pass,\nand only evaluate the lights of a fragment's cluster in the lighting pass.", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z);
+			}
+			ImGui::Checkbox("CPU Light Culling", &mCpuLightCulling);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Cull the point and spot lights against the view frustum on the CPU, and only upload the visible ones,\nsorted by their importance on screen (their bounding spheres depend on the light cutoff intensity).");
+			}
+			if (mClusteredShading || mLightVolumes || mStochasticLights || mCpuLightCulling) {
+				ImGui::SetNextItemWidth(100);
+				ImGui::SliderFloat("Light cutoff intensity", &mLightCutoffIntensity, 0.0005f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+			}
 
 			// GUI elements for controlling renderin parameters, passed on to mGBufferPassPipeline and mSkyboxPipeline:
 			ImGui::PushItemWidth(100);
@@ -646,6 +960,16 @@ public:
 
 			ImGui::Checkbox("Wireframe", &mWireframeMode);
 			ImGui::Checkbox("PN on/off", &mPnEnabled);
+			ImGui::Checkbox("Depth Pre-Pass", &mDepthPrePassEnabled);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Lay down depth first, then shade only the visible fragments in the G-Buffer pass.\nHas no effect in wireframe mode.");
+			}
+			ImGui::Checkbox(std::format("Parallel Recording ({} threads)", mSecondaryCommandPools.size()).c_str(), &mParallelRecordingEnabled);
+			ImGui::Checkbox("Cache Scene Command Buffers", &mCacheSceneCommandBuffers);
+			ImGui::Checkbox("Device-Local Lights Buffer", &mDeviceLocalLights);
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Upload the lights through a staging copy into device-local memory,\ninstead of writing them into persistently mapped host coherent memory.");
+			}
 			
 			ImGui::Separator();
 			// GUI elements for the light sources, enables showing/hiding light gizmos, and the light source editor:
@@ -754,9 +1078,12 @@ public:
 				// swap out:
 				std::swap(*newFramebuffer, *mFramebuffer);
 
+				// The lighting history must have the new resolution, too (its contents are discarded):
+				create_lighting_history_images();
+
 				// configer all post processing effects with the updated images
 
-				mAmbientOcclusion.config(*mQueue, mDescriptorCache,
+				mAmbientOcclusion.config(*mQueue, mDescriptorCache, mFrameGraph,
 					mUniformsBuffer,
 					mFramebuffer->image_views()[0],
 					mFramebuffer->image_views()[1],
@@ -764,7 +1091,7 @@ public:
 					mStorageImageViewsHdr[0] // <-- Destination
 				);
 
-				mReflections.config(*mQueue, mDescriptorCache,
+				mReflections.config(*mQueue, mDescriptorCache, mFrameGraph,
 					mUniformsBuffer,
 					mStorageImageViewsHdr[0], // <-- Source colors for reflections shall have ambient occlusion already applied
 					mFramebuffer->image_views()[1],
@@ -774,19 +1101,20 @@ public:
 					mMaterials, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)
 				);
 
-				mToneMapping.config(*mQueue, mDescriptorCache,
+				mToneMapping.config(*mQueue, mDescriptorCache, mFrameGraph,
 					mStorageImageViewsHdr[1],  // <-- HDR input
 					mStorageImageViewsLdr[0]   // <-- Destination
 				);
 
-				mAntiAliasing.config(*mQueue, mDescriptorCache,
+				mAntiAliasing.config(*mQueue, mDescriptorCache, mFrameGraph,
 					mUniformsBuffer,
 					mStorageImageViewsLdr[0],		// <-- Source
 					mFramebuffer->image_views()[1],	// <-- Depth
+					mFramebuffer->image_views()[4],	// <-- Velocity
 					mStorageImageViewsLdr[1]		// <-- Destination
 				);
 
-				mTransferToSwapchain.config(*mQueue,
+				mTransferToSwapchain.config(*mQueue, mSubmissionBatcher,
 					mFramebuffer->image_views()[1], transfer_to_swapchain::transfer_type::copy, layout::shader_read_only_optimal >> layout::shader_read_only_optimal,
 					mStorageImageViewsLdr[1], transfer_to_swapchain::transfer_type::copy, layout::general >> layout::general,
 					// By passing the (optional) intermediate image, instead of copying/blitting directly into the swap chain images, we perform:
@@ -798,23 +1126,64 @@ public:
 				);
 
 				init_gui(true);
+				// The cached command buffers of the scene pass refer to the old framebuffer => re-record them:
+				for (auto& cachedScenePass : mCachedScenePasses) {
+					cachedScenePass.mOutdated = true;
+				}
 				// new == now the old one => destroy in 1 frame:
 				context().main_window()->handle_lifetime(std::move(newFramebuffer));
 			}) 
 			.update(mGBufferPassPipeline) // Update some of the pipelines after the swap chain has changed
 			.update(mGBufferPassWireframePipeline)
+			.update(mGBufferPassNoTessPipeline)
+			.update(mGBufferPassNoTessWireframePipeline)
+			.update(mGBufferPassAfterPrePassPipeline)
+			.update(mGBufferPassNoTessAfterPrePassPipeline)
+			.update(mDepthPrePassPipeline)
+			.update(mDepthPrePassNoTessPipeline)
 			.update(mLightingPassGraphicsPipeline)
+			.update(mLightVolumesPipeline)
 			.update(mSkyboxPipeline);
 		
-		// Also enable shader hot reloading via the updater:
+		// Also enable shader hot reloading via the updater.
+		// The cached command buffers of the scene pass refer to the old pipelines => re-record them:
+		auto invalidateSceneCommandBuffers = [this]() {
+			for (auto& cachedScenePass : mCachedScenePasses) {
+				cachedScenePass.mOutdated = true;
+			}
+		};
 		mUpdater->on(shader_files_changed_event(mGBufferPassPipeline.as_reference()))
-			.update(mGBufferPassPipeline);
+			.update(mGBufferPassPipeline)
+			.invoke(invalidateSceneCommandBuffers);
 		mUpdater->on(shader_files_changed_event(mGBufferPassWireframePipeline.as_reference()))
-			.update(mGBufferPassWireframePipeline);
+			.update(mGBufferPassWireframePipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mGBufferPassNoTessPipeline.as_reference()))
+			.update(mGBufferPassNoTessPipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mGBufferPassNoTessWireframePipeline.as_reference()))
+			.update(mGBufferPassNoTessWireframePipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mGBufferPassAfterPrePassPipeline.as_reference()))
+			.update(mGBufferPassAfterPrePassPipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mGBufferPassNoTessAfterPrePassPipeline.as_reference()))
+			.update(mGBufferPassNoTessAfterPrePassPipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mDepthPrePassPipeline.as_reference()))
+			.update(mDepthPrePassPipeline)
+			.invoke(invalidateSceneCommandBuffers);
+		mUpdater->on(shader_files_changed_event(mDepthPrePassNoTessPipeline.as_reference()))
+			.update(mDepthPrePassNoTessPipeline)
+			.invoke(invalidateSceneCommandBuffers);
 		mUpdater->on(shader_files_changed_event(mLightingPassGraphicsPipeline.as_reference()))
 			.update(mLightingPassGraphicsPipeline);
+		mUpdater->on(shader_files_changed_event(mLightVolumesPipeline.as_reference()))
+			.update(mLightVolumesPipeline);
 		mUpdater->on(shader_files_changed_event(mSkyboxPipeline.as_reference()))
 			.update(mSkyboxPipeline);
+		mUpdater->on(shader_files_changed_event(mLightCullingPipeline.as_reference()))
+			.update(mLightCullingPipeline);
 	}
 
 	// ----------------------- ^^^   INITIALIZATION   ^^^ -----------------------
@@ -855,6 +1224,86 @@ public:
 		}
 	}
 
+	/**	Records all draw calls of mDrawCalls into secondary command buffers, which can then be executed in the given sub pass.
+	 *	The draw calls are split into contiguous chunks, one per recording thread, each of which records into a
+	 *	command buffer allocated from its own command pool (command pools must not be accessed from multiple threads).
+	 *	@param	aNoTessPipeline		Pipeline for the draw calls [0, mNumNonTessellatedDrawCalls)
+	 *	@param	aTessPipeline		Pipeline for the remaining, tessellated draw calls
+	 *	@param	aNoTessPositionsOnly	If true, only the positions are bound as vertex buffer for the non-tessellated draw calls (depth pre-pass)
+	 *	@param	aSubpassIndex		The index of the sub pass of aTessPipeline's renderpass, the command buffers will be executed in
+	 *	@param	aDescriptorSets		Descriptor sets to be bound (they must have been retrieved on the main thread, since the descriptor cache is not thread-safe)
+	 *	@param	aNumThreads		Number of threads to record on, must not exceed the number of mSecondaryCommandPools
+	 *	@param	aReusable		If true, the command buffers are recorded s.t. they can be executed in multiple frames (which might be in flight at the same time)
+	 *	@return	The recorded secondary command buffers, in the order in which they have to be executed
+	 */
+	std::vector<avk::command_buffer> record_draw_calls_into_secondary_command_buffers(avk::graphics_pipeline_t& aNoTessPipeline, avk::graphics_pipeline_t& aTessPipeline, bool aNoTessPositionsOnly, uint32_t aSubpassIndex, const std::vector<avk::descriptor_set>& aDescriptorSets, size_t aNumThreads, bool aReusable)
+	{
+		assert(aNumThreads >= 1 && aNumThreads <= mSecondaryCommandPools.size());
+		const auto numThreads = aNumThreads;
+		const auto numDrawCalls = mDrawCalls.size();
+		const auto usageFlags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | (aReusable ? vk::CommandBufferUsageFlagBits::eSimultaneousUse : vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		const auto chunkSize = (numDrawCalls + numThreads - 1) / numThreads;
+
+		const auto inheritanceInfo = vk::CommandBufferInheritanceInfo{}
+			.setRenderPass(aTessPipeline.renderpass_reference().handle())
+			.setSubpass(aSubpassIndex)
+			.setFramebuffer(mFramebuffer->handle());
+
+		auto recordChunk = [&, this](size_t aThreadIndex) -> avk::command_buffer {
+			auto cmdBfr = mSecondaryCommandPools[aThreadIndex]->alloc_command_buffer(usageFlags, vk::CommandBufferLevel::eSecondary);
+			const vk::CommandBuffer& vkHppCommandBuffer = cmdBfr->handle();
+			vkHppCommandBuffer.begin(vk::CommandBufferBeginInfo{ usageFlags, &inheritanceInfo });
+
+			const auto begin = std::min(aThreadIndex * chunkSize, numDrawCalls);
+			const auto end   = std::min(begin + chunkSize, numDrawCalls);
+			avk::graphics_pipeline_t* boundPipeline = nullptr;
+			for (size_t i = begin; i < end; ++i) {
+				const bool isTessellated = i >= mNumNonTessellatedDrawCalls;
+				auto* pipeline = isTessellated ? &aTessPipeline : &aNoTessPipeline;
+				if (pipeline != boundPipeline) {
+					// Bind the pipeline and all resources we need in shaders (a chunk contains at most one pipeline switch):
+					vkHppCommandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->handle());
+					for (const auto& descriptorSet : aDescriptorSets) {
+						vkHppCommandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->layout_handle(), descriptorSet.set_id(), descriptorSet.handle(), {});
+					}
+					boundPipeline = pipeline;
+				}
+
+				// We're using the raw Vulkan-Hpp functions here, since they do not touch any of the framework's shared state:
+				const auto& drawCall = mDrawCalls[i];
+				const push_constants_for_draw pushConstants{ drawCall.mModelMatrix, drawCall.mMaterialIndex };
+				vkHppCommandBuffer.pushConstants(pipeline->layout_handle(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eTessellationControl | vk::ShaderStageFlagBits::eTessellationEvaluation, 0u, sizeof(pushConstants), &pushConstants);
+				const auto vertexBuffers = avk::make_array<vk::Buffer>(
+					drawCall.mPositionsBuffer->handle(),  // Vertex buffer at index #0
+					drawCall.mTexCoordsBuffer->handle(),  // Vertex buffer at index #1
+					drawCall.mNormalsBuffer->handle(),    // Vertex buffer at index #2
+					drawCall.mTangentsBuffer->handle(),   // Vertex buffer at index #3
+					drawCall.mBitangentsBuffer->handle()  // Vertex buffer at index #4
+				);
+				const std::array<vk::DeviceSize, 5> offsets{};
+				const uint32_t numVertexBuffers = (aNoTessPositionsOnly && !isTessellated) ? 1u : 5u;
+				vkHppCommandBuffer.bindVertexBuffers(0u, numVertexBuffers, vertexBuffers.data(), offsets.data());
+				vkHppCommandBuffer.bindIndexBuffer(drawCall.mIndexBuffer->handle(), 0u, vk::IndexType::eUint32);
+				vkHppCommandBuffer.drawIndexed(static_cast<uint32_t>(drawCall.mIndexBuffer->meta<avk::index_buffer_meta>().num_elements()), 1u, 0u, 0u, 0u);
+			}
+
+			vkHppCommandBuffer.end();
+			return cmdBfr;
+		};
+
+		// Record the first chunk on this thread, all the others on worker threads:
+		std::vector<std::future<avk::command_buffer>> futures;
+		for (size_t t = 1; t < numThreads; ++t) {
+			futures.push_back(std::async(std::launch::async, recordChunk, t));
+		}
+		std::vector<avk::command_buffer> result;
+		result.push_back(recordChunk(0));
+		for (auto& f : futures) {
+			result.push_back(f.get());
+		}
+		return result;
+	}
+
 	/**	TODO: Render callback which is invoked by the framework every frame after every update() callback has been invoked.
 	 *	Here, we handle everything drawing-related, which includes updating/uploading all buffers, and issuing all draw calls.
 	 *
@@ -877,64 +1326,235 @@ public:
 		// We get the semaphore here, and use it further down to describe a dependency of our recorded commands:
 		auto imageAvailableSemaphore = context().main_window()->consume_current_image_available_semaphore();
 
+		// Use the buffers which belong to the current frame in flight, s.t. we don't overwrite data which is still in use by previous frames:
+		const auto inFlightIndex = context().main_window()->in_flight_index_for_frame();
+		buffer& currentUniformsBuffer = mUniformsBuffer[inFlightIndex];
+		buffer& currentLightsBuffer = mDeviceLocalLights ? mDeviceLocalLightsBuffer[inFlightIndex] : mLightsBuffer[inFlightIndex];
+
 		// Let Temporal Anti-Aliasing modify the camera's projection matrix (it will restore it after it has processed the current frame):
 		mAntiAliasing.save_view_matrix_and_modify_projection_matrix();
 
+		// The light volumes take precedence over the stochastic lighting:
+		const bool stochasticLights = mStochasticLights && !mLightVolumes;
+
 		// Update the data in our uniform buffers:
-		matrices_and_user_input uni;
+		// Since this buffer has its backing memory in a "host coherent" memory region, which stays mapped, we just need to write the new data to it.
+		// No command has to be submitted to a queue. If its backing memory was in a "device" memory region, we would have to, though.
+		auto& uni = *static_cast<matrices_and_user_input*>(mUniformsMappings[inFlightIndex].get());
 		uni.mViewMatrix        = mQuakeCam.view_matrix();
 		uni.mProjMatrix        = mQuakeCam.projection_matrix();
 		uni.mInverseProjMatrix = glm::inverse(uni.mProjMatrix);
 		uni.mCamPos            = glm::translate(mQuakeCam.translation());
 		uni.mUserInput         = glm::vec4{ mTessellationLevel, mDisplacementStrength, mPnEnabled ? 1.0f : 0.0f, 0.0f };
 		uni.mUserInput[3]      = 1.0f; // Always reconstruct position from depth
-
-		// Since this buffer has its backing memory in a "host visible" memory region, we just need to write the new data to it.
-		// No need to submit the (empty, in this case!) action_type_command that is returned by buffer_t::fill() to a queue.
-		// If its backing memory was in a "device" memory region, we would have to, though (see lights buffer below for the difference!).
-		mUniformsBuffer->fill(&uni, 0);
+		uni.mClusteringParams  = glm::vec4{ mQuakeCam.near_plane_distance(), mQuakeCam.far_plane_distance(), mLightCutoffIntensity, mLightVolumes ? 2.0f : stochasticLights ? 3.0f : mClusteredShading ? 1.0f : 0.0f };
+		// The stochastic lighting is blended with the previous frame's result, if it has been written in the previous frame:
+		const auto frameId = context().main_window()->current_frame();
+		const bool lightingHistoryValid = stochasticLights && mLightingHistoryFrameId == frameId - 1;
+		uni.mViewToHistoryClipMatrix = mLightingHistoryViewProjMatrix * glm::inverse(uni.mViewMatrix);
+		uni.mStochasticLightsParams = glm::vec4{ static_cast<float>(mStochasticLightSamples), static_cast<float>(mStochasticLightCandidates), lightingHistoryValid ? mStochasticLightsAlpha : 1.0f, static_cast<float>(frameId % 65536) };
+		uni.mUnjitteredProjMatrix = mAntiAliasing.unjittered_projection_matrix();
+		uni.mViewToPrevClipMatrix = mAntiAliasing.history_view_projection_matrix() * glm::inverse(uni.mViewMatrix);
 
 		// Animate lights:
 		if (mLightsAnimating) {
 			helpers::animate_lights(helpers::get_lights(), time().time_since_start() - mLightAniTimeSub);
 		}
 
-		// Update the data in our light sources buffer:
-		auto activeLights = helpers::get_active_lightsources(mLimitNumPointlights);
-		lightsource_data lightsData{
-			glm::uvec4{
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::ambient),
-				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::directional),
-				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::directional)
-			},
-			glm::uvec4{
+		// Update the data in our light sources buffer (measure the time it takes on the CPU to compare both upload paths).
+		// The light sources are stored in world space, s.t. they need not be uploaded again just because the camera has moved.
+		// The persistently mapped buffer of each frame in flight remembers up to which revision of the lights editor it is up to date,
+		// s.t. only the light sources which have been modified since then (by the editor or by animate_lights) must be written:
+		const auto uploadStart = std::chrono::high_resolution_clock::now();
+		auto* lightsEditor = current_composition()->element_by_type<lights_editor>();
+		// If the lights are culled on the CPU, the visible set (and thereby every light's index) depends on the camera => always upload all of them.
+		const bool fullLightsUpload = mDeviceLocalLights || mCpuLightCulling || nullptr == lightsEditor
+			|| lightsEditor->active_set_revision(mLimitNumPointlights) > mLightsRevisions[inFlightIndex];
+		mNumLightsUploaded = 0;
+		if (!fullLightsUpload) {
+			// The set of active light sources has not changed since the last full upload into this buffer => it is large enough:
+			auto* mappedLightData = reinterpret_cast<lightsource_gpu_data*>(static_cast<helpers::lightsource_data_header*>(mLightsMappings[inFlightIndex].get()) + 1);
+			lightsEditor->for_each_active_light_modified_after(mLightsRevisions[inFlightIndex], mLimitNumPointlights, [&](size_t aActiveIndex, const lightsource& aLight) {
+				if (aActiveIndex < mLightsBufferCapacity[inFlightIndex]) {
+					mappedLightData[aActiveIndex] = convert_for_gpu_usage<std::array<lightsource_gpu_data, 1>>(std::vector<lightsource>{ aLight }, glm::mat4{ 1.0f })[0];
+					++mNumLightsUploaded;
+				}
+			});
+		}
+		auto activeLights = fullLightsUpload ? helpers::get_active_lightsources(mLimitNumPointlights) : std::vector<lightsource>{};
+		if (fullLightsUpload && mCpuLightCulling) {
+			// Only upload the light sources which can affect anything inside the view frustum, the most important ones of each type first:
+			activeLights = helpers::cull_and_sort_lightsources(activeLights, uni.mProjMatrix * uni.mViewMatrix, mQuakeCam.translation(), mLightCutoffIntensity);
+		}
+		// The device-local path (only kept for comparison) needs a staging copy of all light sources, which is recorded into the scene pass' command buffer below:
+		auto lightsUpload = command::action_type_command{};
+		if (fullLightsUpload) {
+			mNumLightsUploaded = static_cast<int>(activeLights.size());
+			// Grow the current frame in flight's buffer if there are more active light sources than it can hold. The old one might still be in use:
+			auto& capacity = mDeviceLocalLights ? mDeviceLocalLightsBufferCapacity[inFlightIndex] : mLightsBufferCapacity[inFlightIndex];
+			const auto newCapacity = helpers::get_lights_buffer_capacity(capacity, activeLights.size());
+			if (newCapacity != capacity) {
+				auto newLightsBuffer = helpers::create_lights_buffer(mDeviceLocalLights ? memory_usage::device : memory_usage::host_coherent, newCapacity);
+				if (!mDeviceLocalLights) {
+					// This unmaps the old buffer, which is kept alive until no frame in flight uses it anymore:
+					mLightsMappings[inFlightIndex] = newLightsBuffer->map_memory(mapping_access::write);
+				}
+				context().main_window()->handle_lifetime(std::move(currentLightsBuffer));
+				currentLightsBuffer = std::move(newLightsBuffer);
+				capacity = newCapacity;
+				// Cached command buffers and the reflections still refer to the old buffer:
+				mCachedScenePasses[inFlightIndex].mOutdated = true;
+#ifdef RTX_ON
+				mReflections.set_lights_buffer(inFlightIndex, currentLightsBuffer);
+#endif
+			}
+			if (mDeviceLocalLights) {
+				std::vector<uint8_t> lightsData(helpers::get_lights_buffer_size(capacity), 0);
+				helpers::write_lightsource_data(activeLights, glm::mat4{ 1.0f }, lightsData.data()); // world space
+				lightsUpload = currentLightsBuffer->fill(lightsData.data(), 0);
+			}
+			else {
+				// Write all the data into the persistently mapped buffer of the current frame in flight:
+				helpers::write_lightsource_data(activeLights, glm::mat4{ 1.0f }, mLightsMappings[inFlightIndex].get()); // world space
+			}
+			// The light volumes are drawn per type, hence the host needs to know the ranges, too:
+			mLightRangesPointSpot[inFlightIndex] = glm::uvec4{
 				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::point),
 				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::point),
 				helpers::get_lightsource_type_begin_index(activeLights, lightsource_type::spot),
 				helpers::get_lightsource_type_end_index(activeLights, lightsource_type::spot)
-			},
-			convert_for_gpu_usage<std::array<lightsource_gpu_data, MAX_NUMBER_OF_LIGHTSOURCES>>(activeLights, mQuakeCam.view_matrix())
-		};
-		auto lightsSemaphore = context().record_and_submit_with_semaphore(
-			// The buffer's backing memory is in a "device" memory region. Therefore, the data must first be copied into 
-			// a host visible buffer (done internally) and then transferred onto the device, into that device memory.
-			// This process must be synchronized => we need to submit the action_type_command to a queue:
-			{ mLightsBuffer->fill(&lightsData, 0) },
-			*mQueue, 
-			stage::copy
-		);
-		// Upon completion of this ^ memory transfer into device memory, a semaphore is signaled.
-		// We can use this semaphore so that other work must wait on it.
-
-		// Alloc a new command buffer for the current frame, which we are going to record commands into, and then submit to the queue:
+			};
+		}
+		// The mapped buffer is only up to date if it has actually been written (i.e., not if the device-local buffer has been used instead),
+		// and if its indices correspond to the active set of light sources (i.e., not if they have been culled):
+		mLightsRevisions[inFlightIndex] = nullptr != lightsEditor && !mDeviceLocalLights && !mCpuLightCulling ? lightsEditor->revision() : 0;
+		const auto uploadDuration = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - uploadStart).count();
+		mLightsUploadCpuTime = mLightsUploadCpuTime * 0.9f + uploadDuration * 0.1f;
+
+		// For the stochastic lighting, build an alias table over the point and spot lights, which refers to them by their indices in the lights buffer:
+		if (stochasticLights) {
+			if (!fullLightsUpload) {
+				// Only written partially above, which implies that they have not been culled => they are stored in the order of the active light sources:
+				activeLights = helpers::get_active_lightsources(mLimitNumPointlights);
+			}
+			const auto aliasTable = helpers::build_light_alias_table(activeLights, mLightCutoffIntensity, mQuakeCam.far_plane_distance());
+			auto& capacity = mLightAliasTableCapacity[inFlightIndex];
+			const auto newCapacity = helpers::get_lights_buffer_capacity(capacity, aliasTable.size());
+			if (newCapacity != capacity) {
+				auto newAliasTableBuffer = context().create_buffer(memory_usage::host_coherent, {}, storage_buffer_meta::create_from_size(helpers::get_light_alias_table_size(newCapacity)));
+				mLightAliasTableMappings[inFlightIndex] = newAliasTableBuffer->map_memory(mapping_access::write);
+				context().main_window()->handle_lifetime(std::move(mLightAliasTableBuffer[inFlightIndex]));
+				mLightAliasTableBuffer[inFlightIndex] = std::move(newAliasTableBuffer);
+				capacity = newCapacity;
+			}
+			auto* header = static_cast<helpers::light_alias_table_header*>(mLightAliasTableMappings[inFlightIndex].get());
+			header->mNumEntries = static_cast<uint32_t>(aliasTable.size());
+			std::memcpy(header + 1, aliasTable.data(), aliasTable.size() * sizeof(helpers::light_alias_table_entry));
+		}
+		// Alloc a new command buffer for the current frame, which we are going to record commands into, and then hand over to the submission batcher:
 		auto cmdBfr = mCommandPool->alloc_command_buffer(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 
-		// Determine which pipelines to use:
-		auto& scenePipeline = mWireframeMode ? mGBufferPassWireframePipeline.as_reference() : mGBufferPassPipeline.as_reference();
+		// Determine which pipelines to use (the depth pre-pass is not used in wireframe mode):
+		const bool depthPrePass = mDepthPrePassEnabled && !mWireframeMode;
+		auto& scenePipeline       = mWireframeMode ? mGBufferPassWireframePipeline.as_reference()
+		                          : depthPrePass   ? mGBufferPassAfterPrePassPipeline.as_reference()       : mGBufferPassPipeline.as_reference();
+		auto& sceneNoTessPipeline = mWireframeMode ? mGBufferPassNoTessWireframePipeline.as_reference()
+		                          : depthPrePass   ? mGBufferPassNoTessAfterPrePassPipeline.as_reference() : mGBufferPassNoTessPipeline.as_reference();
+
+		// If enabled, record the scene's draw calls into secondary command buffers (on multiple threads).
+		// All per-frame data reaches them through mUniformsBuffer and mLightsBuffer, hence they can be cached (per frame in flight)
+		// and replayed until the pipelines, the framebuffer, or any of the settings below change:
+		const bool parallelRecording = mParallelRecordingEnabled && mSecondaryCommandPools.size() > 1;
+		const auto numRecordingThreads = parallelRecording ? mSecondaryCommandPools.size() : size_t{ 1 };
+		const auto sceneState = std::make_tuple(mWireframeMode, depthPrePass, parallelRecording, mDeviceLocalLights);
+		auto& cachedScenePass = mCachedScenePasses[inFlightIndex];
+		std::vector<avk::command_buffer> oneTimeDepthPrePassCommandBuffers;
+		std::vector<avk::command_buffer> oneTimeGBufferPassCommandBuffers;
+		auto recordSceneCommandBuffers = [&](std::vector<avk::command_buffer>& aDepthPrePassDst, std::vector<avk::command_buffer>& aGBufferPassDst, bool aReusable) {
+			const auto descriptorSets = mDescriptorCache->get_or_create_descriptor_sets({
+				descriptor_binding(0, 0, mMaterials),
+				descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+				descriptor_binding(1, 0, currentUniformsBuffer),
+				descriptor_binding(1, 1, currentLightsBuffer)
+			});
+			if (depthPrePass) {
+				aDepthPrePassDst = record_draw_calls_into_secondary_command_buffers(mDepthPrePassNoTessPipeline.as_reference(), mDepthPrePassPipeline.as_reference(), true, 0u, descriptorSets, numRecordingThreads, aReusable);
+			}
+			aGBufferPassDst = record_draw_calls_into_secondary_command_buffers(sceneNoTessPipeline, scenePipeline, false, 1u, descriptorSets, numRecordingThreads, aReusable);
+		};
+		if (mCacheSceneCommandBuffers) {
+			if (cachedScenePass.mOutdated || sceneState != cachedScenePass.mSceneState) {
+				// The previously cached command buffers might still be in use by a frame in flight:
+				for (auto& cached : cachedScenePass.mDepthPrePassCommandBuffers) {
+					context().main_window()->handle_lifetime(std::move(cached));
+				}
+				for (auto& cached : cachedScenePass.mGBufferPassCommandBuffers) {
+					context().main_window()->handle_lifetime(std::move(cached));
+				}
+				cachedScenePass.mDepthPrePassCommandBuffers.clear();
+				cachedScenePass.mGBufferPassCommandBuffers.clear();
+				recordSceneCommandBuffers(cachedScenePass.mDepthPrePassCommandBuffers, cachedScenePass.mGBufferPassCommandBuffers, true);
+				cachedScenePass.mSceneState = sceneState;
+				cachedScenePass.mOutdated = false;
+			}
+		}
+		else if (parallelRecording) {
+			recordSceneCommandBuffers(oneTimeDepthPrePassCommandBuffers, oneTimeGBufferPassCommandBuffers, false);
+		}
+		const auto& depthPrePassCommandBuffers = mCacheSceneCommandBuffers ? cachedScenePass.mDepthPrePassCommandBuffers : oneTimeDepthPrePassCommandBuffers;
+		const auto& gBufferPassCommandBuffers  = mCacheSceneCommandBuffers ? cachedScenePass.mGBufferPassCommandBuffers  : oneTimeGBufferPassCommandBuffers;
+		// Executes previously recorded secondary command buffers:
+		auto executeAll = [](const vk::CommandBuffer& aCommandBuffer, const std::vector<avk::command_buffer>& aSecondaryCommandBuffers) {
+			std::vector<vk::CommandBuffer> handles;
+			for (const auto& secondary : aSecondaryCommandBuffers) {
+				handles.push_back(secondary->handle());
+			}
+			aCommandBuffer.executeCommands(handles);
+		};
 
 		context().record({ // Record a bunch of commands (which can be a mix of state-type commands and action-type commands):
 
+			// If the lights buffer's backing memory is in a "device" memory region, the data must first be copied into 
+			// a host visible buffer (done internally) and then transferred onto the device, into that device memory.
+			// Instead of submitting this transfer separately, we record it at the beginning of the scene pass' command buffer:
+			command::custom_commands([&](avk::command_buffer_t& cb) {
+				if (mDeviceLocalLights) {
+					helpers::record_timing_interval_start(cb.handle(), std::format("lights upload {}", inFlightIndex));
+				}
+			}),
+			std::move(lightsUpload),
+			// The lights are accessed in the light culling and fragment shaders => these stages must wait for the transfer (if there has been one)!
+			// The same applies to the lighting history, which has been copied at the end of the previous frame:
+			sync::global_memory_barrier(stage::copy >> stage::compute_shader | stage::fragment_shader, access::transfer_write >> access::shader_storage_read | access::shader_sampled_read),
+			command::custom_commands([&](avk::command_buffer_t& cb) {
+				if (mDeviceLocalLights) {
+					helpers::record_timing_interval_end(cb.handle(), std::format("lights upload {}", inFlightIndex));
+				}
+			}),
+
+			// Assign the point and spot lights to the clusters, s.t. the lighting pass only has to evaluate those affecting a fragment's cluster.
+			// Since this only depends on the camera and the lights, it is done before the renderpass:
+			command::custom_commands([&,this](avk::command_buffer_t& cb) {
+				if (!mClusteredShading || mLightVolumes || stochasticLights) {
+					return;
+				}
+				helpers::record_timing_interval_start(cb.handle(), std::format("light culling {}", inFlightIndex));
+				auto& currentLightClustersBuffer = mLightClustersBuffer[inFlightIndex];
+				// Reset the counter of allocated light indices:
+				cb.handle().fillBuffer(currentLightClustersBuffer->handle(), 0, sizeof(uint32_t), 0u);
+				cb.record(sync::global_memory_barrier(stage::transfer >> stage::compute_shader, access::transfer_write >> access::shader_storage_read | access::shader_storage_write));
+				cb.record(avk::command::bind_pipeline(mLightCullingPipeline.as_reference()));
+				cb.record(avk::command::bind_descriptors(mLightCullingPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+					descriptor_binding(0, 0, currentUniformsBuffer),
+					descriptor_binding(0, 1, currentLightsBuffer),
+					descriptor_binding(0, 2, currentLightClustersBuffer)
+				})));
+				cb.handle().dispatch((NUMBER_OF_LIGHT_CLUSTERS + LIGHT_CULLING_WORKGROUP_SIZE - 1) / LIGHT_CULLING_WORKGROUP_SIZE, 1u, 1u);
+				// The lighting pass' fragment shader reads the clusters:
+				cb.record(sync::global_memory_barrier(stage::compute_shader >> stage::fragment_shader, access::shader_storage_write >> access::shader_storage_read));
+				helpers::record_timing_interval_end(cb.handle(), std::format("light culling {}", inFlightIndex));
+			}),
+
 			command::custom_commands([&,this](avk::command_buffer_t& cb) {
 					// Note 1: The Vulkan SDK's command buffer class (from Vulkan-Hpp in this case) provides 
 					//         ALL the commands there are. Use it to record anything into the command buffer:
@@ -943,28 +1563,64 @@ public:
 					// Note 2: For some commands, the framework's avk::command_buffer_t class provides methods,
 					//         which allow more convenient usage/recording of functionality into the command buffer.
 					//         The following code uses mostly these avk::command_buffer_t methods:
-					cb.record(command::begin_render_pass_for_framebuffer(scenePipeline.renderpass_reference(), mFramebuffer.as_reference()));
-					
-					// Bind the pipeline for subsequent draw calls:
-					cb.record(command::bind_pipeline(scenePipeline));
-					// Bind all resources we need in shaders:
-					cb.record(avk::command::bind_descriptors(scenePipeline.layout(), mDescriptorCache->get_or_create_descriptor_sets({
-						descriptor_binding(0, 0, mMaterials),
-						descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
-						descriptor_binding(1, 0, mUniformsBuffer),
-						descriptor_binding(1, 1, mLightsBuffer)
-					})));
+					helpers::record_timing_interval_start(vkHppCommandBuffer, std::format("scene pass {}", inFlightIndex));
+
+					// The sub passes which are recorded into secondary command buffers must not contain any inline commands:
+					cb.record(command::begin_render_pass_for_framebuffer(scenePipeline.renderpass_reference(), mFramebuffer.as_reference(), { 0, 0 }, {}, depthPrePassCommandBuffers.empty()));
+
+					// Draws the given range of mDrawCalls with the given pipeline, binding it only once.
+					// If aPositionsOnly is set, only the positions are bound as vertex buffer (for the depth pre-pass):
+					auto drawRange = [&](avk::graphics_pipeline_t& aPipeline, size_t aBegin, size_t aEnd, bool aPositionsOnly = false) {
+						if (aBegin == aEnd) {
+							return;
+						}
+						// Bind the pipeline for subsequent draw calls:
+						cb.record(command::bind_pipeline(aPipeline));
+						// Bind all resources we need in shaders:
+						cb.record(avk::command::bind_descriptors(aPipeline.layout(), mDescriptorCache->get_or_create_descriptor_sets({
+							descriptor_binding(0, 0, mMaterials),
+							descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+							descriptor_binding(1, 0, currentUniformsBuffer),
+							descriptor_binding(1, 1, currentLightsBuffer)
+						})));
+
+						for (size_t i = aBegin; i < aEnd; ++i) {
+							const auto& drawCall = mDrawCalls[i];
+							cb.record(avk::command::push_constants(aPipeline.layout(), push_constants_for_draw{ drawCall.mModelMatrix, drawCall.mMaterialIndex }));
+							if (aPositionsOnly) {
+								cb.record(avk::command::draw_indexed(drawCall.mIndexBuffer.as_reference(), drawCall.mPositionsBuffer.as_reference()));
+								continue;
+							}
+							cb.record(avk::command::draw_indexed(
+								drawCall.mIndexBuffer.as_reference(),     // Index buffer
+								drawCall.mPositionsBuffer.as_reference(), // Vertex buffer at index #0
+								drawCall.mTexCoordsBuffer.as_reference(), // Vertex buffer at index #1
+								drawCall.mNormalsBuffer.as_reference(),   // Vertex buffer at index #2
+								drawCall.mTangentsBuffer.as_reference(),  // Vertex buffer at index #3
+								drawCall.mBitangentsBuffer.as_reference() // Vertex buffer at index #4
+							));
+						}
+					};
+
+					// mDrawCalls is sorted such that all the non-tessellated draw calls come first.
+					// FIRST sub pass: Lay down the depth values (if enabled, otherwise this sub pass remains empty):
+					if (!depthPrePassCommandBuffers.empty()) {
+						executeAll(vkHppCommandBuffer, depthPrePassCommandBuffers);
+					}
+					else if (depthPrePass) {
+						drawRange(mDepthPrePassNoTessPipeline.as_reference(), 0, mNumNonTessellatedDrawCalls, true);
+						drawRange(mDepthPrePassPipeline.as_reference(), mNumNonTessellatedDrawCalls, mDrawCalls.size());
+					}
+
+					cb.record(avk::command::next_subpass(gBufferPassCommandBuffers.empty()));
 
-					for (const auto& drawCall : mDrawCalls) {
-						cb.record(avk::command::push_constants(scenePipeline.layout(), push_constants_for_draw{ drawCall.mModelMatrix, drawCall.mMaterialIndex }));
-						cb.record(avk::command::draw_indexed(
-							drawCall.mIndexBuffer.as_reference(),     // Index buffer
-							drawCall.mPositionsBuffer.as_reference(), // Vertex buffer at index #0
-							drawCall.mTexCoordsBuffer.as_reference(), // Vertex buffer at index #1
-							drawCall.mNormalsBuffer.as_reference(),   // Vertex buffer at index #2
-							drawCall.mTangentsBuffer.as_reference(),  // Vertex buffer at index #3
-							drawCall.mBitangentsBuffer.as_reference() // Vertex buffer at index #4
-						));
+					// SECOND sub pass: Fill the G-Buffer
+					if (!gBufferPassCommandBuffers.empty()) {
+						executeAll(vkHppCommandBuffer, gBufferPassCommandBuffers);
+					}
+					else {
+						drawRange(sceneNoTessPipeline, 0, mNumNonTessellatedDrawCalls);
+						drawRange(scenePipeline, mNumNonTessellatedDrawCalls, mDrawCalls.size());
 					}
 
 					cb.record(avk::command::next_subpass());
@@ -974,46 +1630,143 @@ public:
 					cb.record(avk::command::bind_descriptors(mLightingPassGraphicsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
 						descriptor_binding(0, 0, mMaterials),
 						descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
-						descriptor_binding(1, 0, mUniformsBuffer),
-						descriptor_binding(1, 1, mLightsBuffer),
-						descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+						descriptor_binding(1, 0, currentUniformsBuffer),
+						descriptor_binding(1, 1, currentLightsBuffer),
+						descriptor_binding(1, 2, mLightClustersBuffer[inFlightIndex]),
+						descriptor_binding(1, 3, mLightAliasTableBuffer[inFlightIndex]),
+						descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::depth_stencil_read_only_optimal), shader_type::fragment),
 						descriptor_binding(2, 1, mFramebuffer->image_view_at(2)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
-						descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment)
+						descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+						descriptor_binding(2, 3, mLightingHistorySampler, shader_type::fragment),
+						descriptor_binding(2, 4, mLightingHistoryColor->as_sampled_image(layout::general), shader_type::fragment),
+						descriptor_binding(2, 5, mLightingHistoryDepth->as_sampled_image(layout::general), shader_type::fragment)
 #ifdef RTX_ON
 						, descriptor_binding(3, 0, mTopLevelAS)
 #endif
 					})));
+					helpers::record_timing_interval_start(vkHppCommandBuffer, std::format("lighting {}", inFlightIndex));
 					// Let's just use the raw Vulkan-Hpp class for the draw call, because we don't need any convenience functionality here:
 					vkHppCommandBuffer.draw(6u, 1u, 0u, 1u);
 
+					if (mLightVolumes) {
+						// Draw one sphere per point light and one cone per spot light. The first instance is the index of the first light
+						// source of each type, s.t. gl_InstanceIndex directly refers to the light source (see light_volume.vert):
+						cb.record(avk::command::bind_pipeline(mLightVolumesPipeline.as_reference()));
+						cb.record(avk::command::bind_descriptors(mLightVolumesPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+							descriptor_binding(0, 0, mMaterials),
+							descriptor_binding(0, 1, as_combined_image_samplers(mImageSamplers, layout::shader_read_only_optimal)),
+							descriptor_binding(1, 0, currentUniformsBuffer),
+							descriptor_binding(1, 1, currentLightsBuffer),
+							descriptor_binding(2, 0, mFramebuffer->image_view_at(1)->as_input_attachment(layout::depth_stencil_read_only_optimal), shader_type::fragment),
+							descriptor_binding(2, 1, mFramebuffer->image_view_at(2)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment),
+							descriptor_binding(2, 2, mFramebuffer->image_view_at(3)->as_input_attachment(layout::shader_read_only_optimal), shader_type::fragment)
+						})));
+						const auto& ranges = mLightRangesPointSpot[inFlightIndex];
+						auto drawVolumes = [&vkHppCommandBuffer](const simple_geometry& aVolume, uint32_t aBegin, uint32_t aEnd) {
+							if (aEnd <= aBegin) {
+								return;
+							}
+							const vk::Buffer vertexBuffer = aVolume.mPositionsBuffer->handle();
+							const vk::DeviceSize offset = 0;
+							vkHppCommandBuffer.bindVertexBuffers(0u, 1u, &vertexBuffer, &offset);
+							vkHppCommandBuffer.bindIndexBuffer(aVolume.mIndexBuffer->handle(), 0u, vk::IndexType::eUint32);
+							vkHppCommandBuffer.drawIndexed(static_cast<uint32_t>(aVolume.mIndexBuffer->meta<avk::index_buffer_meta>().num_elements()), aEnd - aBegin, 0u, 0u, aBegin);
+						};
+						drawVolumes(mLightVolumeSphere, ranges[0], ranges[1]);
+						drawVolumes(mLightVolumeCone,   ranges[2], ranges[3]);
+					}
+					helpers::record_timing_interval_end(vkHppCommandBuffer, std::format("lighting {}", inFlightIndex));
+
 					cb.record(avk::command::next_subpass());
 
 					if (!mWireframeMode) {
 						cb.record(avk::command::bind_pipeline(mSkyboxPipeline.as_reference()));
 						cb.record(avk::command::bind_descriptors(mSkyboxPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-							descriptor_binding(0, 0, mUniformsBuffer)
+							descriptor_binding(0, 0, currentUniformsBuffer)
 						})));
 						cb.record(avk::command::draw_indexed(mSkyboxSphere.mIndexBuffer.as_reference(), mSkyboxSphere.mPositionsBuffer.as_reference()));
 					}
 
 					cb.record(avk::command::end_render_pass());
 
+					helpers::record_timing_interval_end(vkHppCommandBuffer, std::format("scene pass {}", inFlightIndex));
+
 				}),
 			}) // End of command recording
-			.into_command_buffer(cmdBfr)
-			.then_submit_to(*mQueue)
-			// The work package we are submitting to the queue must wait in the EARLY FRAGMENT TESTS for the 
-		    // imageAvailableSemaphore being signaled, because in that stage, the depth buffer is accessed:
-			.waiting_for(imageAvailableSemaphore >> stage::early_fragment_tests)
-			// Hint: We could add further semaphore dependencies here, if we needed to wait on other work, too.
-			.waiting_for(lightsSemaphore >> stage::fragment_shader) // The lights are accessed in the fragment shader => that stage must wait!
-			.submit();
-
-		cmdBfr->handle_lifetime_of(std::move(lightsSemaphore));
-		
-		// Use a convenience function of avk::window to take care of the command buffer's lifetime:
-		// It will get deleted in the future after #concurrent-frames have passed by.
-		context().main_window()->handle_lifetime(std::move(cmdBfr));
+			.into_command_buffer(cmdBfr);
+
+		// All command buffers of this frame are submitted at once by the submission batcher, which also takes care of their lifetimes.
+		// The submission must wait in the EARLY FRAGMENT TESTS for the imageAvailableSemaphore being signaled,
+		// because in that stage, the depth buffer is accessed:
+		mSubmissionBatcher.add_wait(imageAvailableSemaphore->handle(), vk::PipelineStageFlagBits2KHR::eEarlyFragmentTests);
+		// Post processing passes of the previous frame, which run on the async compute queue, might still read the G-Buffer attachments.
+		// Only writing the attachments must wait for them, s.t. the vertex and tessellation stages of this frame can overlap with them:
+		if (mFrameGraph.last_async_compute_value() > 0) {
+			mSubmissionBatcher.add_wait(mFrameGraph.timeline_semaphore(),
+				vk::PipelineStageFlagBits2KHR::eEarlyFragmentTests | vk::PipelineStageFlagBits2KHR::eLateFragmentTests | vk::PipelineStageFlagBits2KHR::eColorAttachmentOutput,
+				mFrameGraph.last_async_compute_value());
+		}
+		mSubmissionBatcher.add(std::move(cmdBfr));
+		// The same applies to the one-time secondary command buffers which are executed by cmdBfr (cached ones are kept):
+		for (auto& secondary : oneTimeDepthPrePassCommandBuffers) {
+			context().main_window()->handle_lifetime(std::move(secondary));
+		}
+		for (auto& secondary : oneTimeGBufferPassCommandBuffers) {
+			context().main_window()->handle_lifetime(std::move(secondary));
+		}
+
+		// Tell the frame graph how the scene pass leaves the G-Buffer attachments, which are read by the post processing passes:
+		for (auto& attachment : mFramebuffer->image_views()) {
+			mFrameGraph.import_image(attachment, layout::shader_read_only_optimal)
+				.produced_by(stage::color_attachment_output | stage::early_fragment_tests | stage::late_fragment_tests,
+				             access::color_attachment_write | access::depth_stencil_attachment_write);
+		}
+		// The depth attachment and the final result are transferred to the swapchain afterwards:
+		mFrameGraph.import_image(mFramebuffer->image_views()[1], layout::shader_read_only_optimal)
+			.produced_by(stage::early_fragment_tests | stage::late_fragment_tests, access::depth_stencil_attachment_write)
+			.consumed_by(stage::early_fragment_tests | stage::late_fragment_tests, access::depth_stencil_attachment_read);
+		mFrameGraph.import_image(mStorageImageViewsLdr[1])
+			.consumed_by(stage::compute_shader | stage::transfer, access::shader_read | access::transfer_read);
+
+		if (stochasticLights) {
+			// Keep the lit scene and its depth for the next frame's lighting pass, which blends the stochastic lighting with them.
+			// (Its reads of the history images are ordered before these copies by the renderpass' dependencies.)
+			mFrameGraph.import_image(mLightingHistoryColor)
+				.produced_by(stage::copy, access::transfer_write)
+				.as_output();
+			mFrameGraph.import_image(mLightingHistoryDepth)
+				.produced_by(stage::copy, access::transfer_write)
+				.as_output();
+			mFrameGraph.add_pass("stochastic lights: update history")
+				.reads(mFramebuffer->image_views()[0], stage::copy, access::transfer_read, layout::transfer_src)
+				.reads(mFramebuffer->image_views()[1], stage::copy, access::transfer_read, layout::transfer_src)
+				.writes(mLightingHistoryColor, stage::copy, access::transfer_write)
+				.writes(mLightingHistoryDepth, stage::copy, access::transfer_write)
+				.records([this](avk::command_buffer_t& cb) {
+					cb.record(copy_image_to_another(mFramebuffer->image_at(0), layout::transfer_src, mLightingHistoryColor->get_image(), layout::general));
+					cb.record(copy_image_to_another(mFramebuffer->image_at(1), layout::transfer_src, mLightingHistoryDepth->get_image(), layout::general, vk::ImageAspectFlagBits::eDepth));
+				});
+			mLightingHistoryFrameId = frameId;
+			mLightingHistoryViewProjMatrix = uni.mProjMatrix * uni.mViewMatrix;
+		}
+	}
+
+	/**	Creates the images which the stochastic lighting is accumulated with, in the same formats and with the
+	 *	same resolution as the color and depth attachments of mFramebuffer, and transitions them into GENERAL layout.
+	 *	This invalidates the lighting history.
+	 */
+	void create_lighting_history_images()
+	{
+		using namespace avk;
+
+		mLightingHistoryColor = context().create_image_view_from_template(mFramebuffer->image_views()[0].as_reference());
+		mLightingHistoryDepth = context().create_image_view_from_template(mFramebuffer->image_views()[1].as_reference());
+		auto fen = context().record_and_submit_with_fence(command::gather(
+			sync::image_memory_barrier(mLightingHistoryColor->get_image(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(mLightingHistoryDepth->get_image(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+		), *mQueue);
+		fen->wait_until_signalled();
+		mLightingHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
 	}
 
 	// ----------------------- ^^^  PER FRAME ACTION  ^^^ -----------------------
@@ -1028,18 +1781,29 @@ private:
 	/** One single queue to submit all the commands to: */
 	avk::queue* mQueue;
 
+	/** A second queue for executing post processing passes asynchronously to the scene pass of the next frame: */
+	avk::queue* mAsyncComputeQueue;
+
 	/** One descriptor cache to use for allocating all the descriptor sets from: */
 	avk::descriptor_cache mDescriptorCache;
 
 	/** A command pool for allocating (single-use) command buffers from: */
 	avk::command_pool mCommandPool;
 
+	/** One command pool per recording thread for allocating the secondary command buffers of the scene pass from: */
+	std::vector<avk::command_pool> mSecondaryCommandPools;
+
+	/** Cached secondary command buffers of the scene pass, one set per frame in flight (they refer to that frame's buffers): */
+	std::vector<cached_scene_pass> mCachedScenePasses;
+
 	/** Buffer containing all the different materials as loaded from 3D models/ORCA scenes: */
 	avk::buffer mMaterials;
 	/** Set of image samplers which are referenced by the materials in mMaterials: */
 	std::vector<avk::image_sampler> mImageSamplers;
 	/** Draw calls which are for all the geometry, references materials mMaterials by index: */
 	std::vector<draw_call> mDrawCalls;
+	/** Number of draw calls at the front of mDrawCalls which are not tessellated, all remaining ones are: */
+	size_t mNumNonTessellatedDrawCalls = 0;
 #ifdef RTX_ON
 	/** Draw calls which are for all the geometry, references materials mMaterials by index: */
 	std::vector<rtx_data_per_draw_call> mRtxData;
@@ -1063,10 +1827,23 @@ private:
 	avk::image_view mImageViewSrgb;
 
 	avk::graphics_pipeline mGBufferPassPipeline, mGBufferPassWireframePipeline;
+	/** Pipelines without tessellation stages, used for all meshes which are not tessellated: */
+	avk::graphics_pipeline mGBufferPassNoTessPipeline, mGBufferPassNoTessWireframePipeline;
+	/** G-Buffer pipelines which test for depth EQUAL, used after the depth pre-pass: */
+	avk::graphics_pipeline mGBufferPassAfterPrePassPipeline, mGBufferPassNoTessAfterPrePassPipeline;
+	/** Depth-only pipelines for the (optional) depth pre-pass: */
+	avk::graphics_pipeline mDepthPrePassPipeline, mDepthPrePassNoTessPipeline;
 	avk::graphics_pipeline mLightingPassGraphicsPipeline;
 
-	avk::buffer mUniformsBuffer;
-	avk::buffer mLightsBuffer;
+	/** Uniform buffers with matrices and user input, and storage buffers with light source data, one of each per frame in flight: */
+	std::vector<avk::buffer> mUniformsBuffer;
+	std::vector<avk::buffer> mLightsBuffer;
+	/** Light source data in device-local memory, filled through a staging copy every frame (only for comparison with mLightsBuffer): */
+	std::vector<avk::buffer> mDeviceLocalLightsBuffer;
+	/** Number of light sources each of the mLightsBuffer and mDeviceLocalLightsBuffer can hold: */
+	std::vector<size_t> mLightsBufferCapacity, mDeviceLocalLightsBufferCapacity;
+	/** mUniformsBuffer and mLightsBuffer stay mapped for as long as they exist: */
+	std::vector<decltype(std::declval<avk::buffer_t&>().map_memory(avk::mapping_access::write))> mUniformsMappings, mLightsMappings;
 	
 	// ------------------ UI Parameters -------------------
 	/** Factor that determines to which amount normals shall be distorted through normal mapping: */
@@ -1080,6 +1857,55 @@ private:
 
 	/** Flag controlled through the UI, indicating whether PN triangles is currently active or not: */
 	bool mPnEnabled = true;
+
+	/** Flag controlled through the UI, indicating whether a depth pre-pass shall be performed before the G-Buffer pass: */
+	bool mDepthPrePassEnabled = false;
+
+	/** Flag controlled through the UI, indicating whether the scene's draw calls shall be recorded on multiple threads: */
+	bool mParallelRecordingEnabled = true;
+
+	/** Flag controlled through the UI, indicating whether the scene's draw calls shall be recorded once and replayed in subsequent frames: */
+	bool mCacheSceneCommandBuffers = true;
+
+	/** Flag controlled through the UI, indicating whether the lights shall be uploaded into device-local memory instead of the persistently mapped buffers: */
+	bool mDeviceLocalLights = false;
+	/** Averaged time (in ms) it takes on the CPU to update the lights buffer: */
+	float mLightsUploadCpuTime = 0.0f;
+	/** The revision of the lights editor up to which the light sources in mLightsBuffer are up to date (per frame in flight): */
+	std::vector<uint64_t> mLightsRevisions;
+	/** How many light sources have been written during the last frame: */
+	int mNumLightsUploaded = 0;
+	/** The clusters (froxels) with the indices of the point and spot lights affecting them, one buffer per frame in flight: */
+	std::vector<avk::buffer> mLightClustersBuffer;
+	/** Compute pipeline which fills mLightClustersBuffer: */
+	avk::compute_pipeline mLightCullingPipeline;
+	/** Flag controlled through the UI, indicating whether the lighting pass shall only evaluate the lights of each fragment's cluster: */
+	bool mClusteredShading = true;
+	/** Flag controlled through the UI, indicating whether the point and spot lights shall be culled against the view frustum before they are uploaded: */
+	bool mCpuLightCulling = false;
+	/** Flag controlled through the UI, indicating whether the point and spot lights shall be added by drawing their light volumes: */
+	bool mLightVolumes = false;
+	/** Start and end indices of the point and spot lights in mLightsBuffer (per frame in flight), used to draw the light volumes: */
+	std::vector<glm::uvec4> mLightRangesPointSpot;
+	/** Intensity below which a light source's contribution is neglected, which determines its radius for the light culling: */
+	float mLightCutoffIntensity = 0.005f;
+	/** Flag controlled through the UI, indicating whether only a fixed number of point and spot lights shall be sampled per pixel, and accumulated over time: */
+	bool mStochasticLights = false;
+	/** Number of light samples per pixel, and number of candidates each of them is chosen from: */
+	int mStochasticLightSamples = 4;
+	int mStochasticLightCandidates = 8;
+	/** Weight of the current frame when the stochastic lighting is blended with the previous frame's result: */
+	float mStochasticLightsAlpha = 0.1f;
+	/** Alias tables over the point and spot lights (one per frame in flight, persistently mapped), and the number of entries they can hold: */
+	std::vector<avk::buffer> mLightAliasTableBuffer;
+	std::vector<size_t> mLightAliasTableCapacity;
+	std::vector<decltype(std::declval<avk::buffer_t&>().map_memory(avk::mapping_access::write))> mLightAliasTableMappings;
+	/** The previous frame's lit scene and depth, which the stochastic lighting is blended with: */
+	avk::image_view mLightingHistoryColor, mLightingHistoryDepth;
+	avk::sampler mLightingHistorySampler;
+	/** The frame in which the lighting history has been written, and the matrix it has been rendered with: */
+	avk::window::frame_id_t mLightingHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
+	glm::mat4 mLightingHistoryViewProjMatrix{ 1.0f };
 	
 	int mLimitNumPointlights = 98 + EXTRA_POINTLIGHTS;
 
@@ -1090,6 +1916,9 @@ private:
 
 	// --------------------- Skybox -----------------------
 	simple_geometry mSkyboxSphere;
+	// --------------------- Light volumes ----------------
+	simple_geometry mLightVolumeSphere, mLightVolumeCone;
+	avk::graphics_pipeline mLightVolumesPipeline;
 	avk::graphics_pipeline mSkyboxPipeline;
 
 	// --------------------- Other -----------------------
@@ -1098,7 +1927,11 @@ private:
 
 	// ----------------------- ^^^  MEMBER VARIABLES  ^^^ -----------------------
 
+	// Submits all command buffers of a frame at once:
+	submission_batcher mSubmissionBatcher;
+
 	// The elements to handle the post processing effects:
+	frame_graph mFrameGraph;
 	ambient_occlusion mAmbientOcclusion;
 	reflections mReflections;
 	tone_mapping mToneMapping;
@@ -1133,7 +1966,7 @@ int main()
 		mainWnd->enable_resizing(true);
 		mainWnd->request_srgb_framebuffer(true);
 		mainWnd->set_presentaton_mode(presentation_mode::mailbox);
-		mainWnd->set_number_of_concurrent_frames(1u); // For simplicity, we are using only one concurrent frame in Assignment 4, otherwise we'd have to duplicate many resources as in Assignment 1
+		mainWnd->set_number_of_concurrent_frames(3u); // Resources which are written from the host (uniforms, lights, TAA matrices) exist once per frame in flight
 		mainWnd->open();
 
 		// Create one single queue which we will submit all command buffers to:
@@ -1142,8 +1975,11 @@ int main()
 		mainWnd->set_queue_family_ownership(singleQueue.family_index());
 		mainWnd->set_present_queue(singleQueue);
 
+		// Create a second queue for executing post processing passes asynchronously (prefer the same queue family, to share all resources):
+		auto& asyncComputeQueue = context().create_queue(vk::QueueFlagBits::eCompute, queue_selection_preference::versatile_queue);
+
 		// Create an instance of our main class which contains the relevant host code for Assignment 1:
-		auto app = assignment4(singleQueue);
+		auto app = assignment4(singleQueue, asyncComputeQueue);
 
 		// Create another element for drawing the GUI via the library Dear ImGui:
 		auto ui = imgui_manager(singleQueue);
@@ -1160,6 +1996,14 @@ int main()
 				features.fillModeNonSolid = VK_TRUE; // this device feature is required for wireframe rendering
 				features.depthBounds = VK_TRUE;
 			},
+			[](vk::PhysicalDeviceVulkan12Features& aVulkan12Featues) {
+				// Timeline semaphores synchronize the async compute queue with the graphics queue:
+				aVulkan12Featues.setTimelineSemaphore(VK_TRUE);
+#ifdef RTX_ON
+				// Also this Vulkan 1.2 feature is required for ray tracing:
+				aVulkan12Featues.setBufferDeviceAddress(VK_TRUE);
+#endif
+			},
 			[](vk::DebugUtilsMessageTypeFlagsEXT& messageTypes) {
 				// Exclude the ePerformance flag to make validation output less verbose:
 				messageTypes = messageTypes & ~vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance;
@@ -1172,10 +2016,6 @@ int main()
 				.add_extension(VK_KHR_RAY_QUERY_EXTENSION_NAME)
 				.add_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
 				.add_extension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME),
-			[](vk::PhysicalDeviceVulkan12Features& aVulkan12Featues) {
-				// Also this Vulkan 1.2 feature is required for ray tracing:
-				aVulkan12Featues.setBufferDeviceAddress(VK_TRUE);
-			},
 			[](vk::PhysicalDeviceAccelerationStructureFeaturesKHR& aAccelerationStructureFeatures) {
 				// Enabling the extensions is not enough, we need to activate ray tracing features explicitly.
 				// Here for usage of acceleration structures:
@@ -0,0 +1,644 @@
+#include "imgui_utils.h"
+
+// This class assembles the post processing passes of a frame into a frame graph, and records them into one command buffer,
+// which is handed over to the submission_batcher.
+// Every pass declares which images and buffers it reads and writes. From these declarations, the frame graph derives
+// the pipeline barriers and layout transitions between the passes, culls passes whose results are never used, and
+// lets transient images whose lifetimes do not overlap share the same image.
+// Passes can optionally be executed on a second (async compute) queue, which is synchronized with the graphics queue
+// through a timeline semaphore, s.t. they can overlap with the next frame's scene pass.
+class frame_graph : public avk::invokee
+{
+public:
+	// The types of the avk::stage::* and avk::access::* values, i.e., (combinations of) pipeline stages and memory accesses:
+	using stage_flags = std::remove_const_t<decltype(avk::stage::none)>;
+	using access_flags = std::remove_const_t<decltype(avk::access::none)>;
+
+private:
+	/** A resource is either an imported image, an imported buffer, or a transient image which is referred to by name. */
+	using resource_key = std::variant<vk::Image, vk::Buffer, std::string>;
+
+	/** Describes one access of a pass to one resource */
+	struct resource_access
+	{
+		resource_key mKey;
+		// The accessed image; nullptr for buffers, and for transient images until an image has been assigned to them:
+		const avk::image_t* mImage;
+		bool mIsWrite;
+		stage_flags mStages;
+		access_flags mAccess;
+		avk::layout::image_layout mLayout;
+	};
+
+	/** Describes which accesses have happened to a resource so far */
+	struct resource_state
+	{
+		avk::layout::image_layout mLayout = avk::layout::general;
+		// Stages and accesses of the last write (or layout transition):
+		stage_flags mWriteStages = avk::stage::none;
+		access_flags mWriteAccess = avk::access::none;
+		// Stages and accesses which the last write has already been made visible to:
+		stage_flags mVisibleStages = avk::stage::none;
+		access_flags mVisibleAccess = avk::access::none;
+		// Stages which have read the resource since the last write:
+		stage_flags mReadStages = avk::stage::none;
+	};
+
+public:
+	/** A pass of the frame graph, which declares the resources it accesses, and records its commands */
+	class pass
+	{
+		friend class frame_graph;
+	public:
+		/** Declares that this pass reads the given image in the given stages, with the given access, and in the given layout. */
+		pass& reads(const avk::image_view& aImageView, stage_flags aStages, access_flags aAccess, avk::layout::image_layout aLayout = avk::layout::general)
+		{
+			mAccesses.push_back({ aImageView->get_image().handle(), &aImageView->get_image(), false, aStages, aAccess, aLayout });
+			return *this;
+		}
+
+		/** Declares that this pass writes the given image in the given stages, with the given access, and in the given layout. */
+		pass& writes(const avk::image_view& aImageView, stage_flags aStages, access_flags aAccess, avk::layout::image_layout aLayout = avk::layout::general)
+		{
+			mAccesses.push_back({ aImageView->get_image().handle(), &aImageView->get_image(), true, aStages, aAccess, aLayout });
+			return *this;
+		}
+
+		/** Declares that this pass reads the given buffer in the given stages, with the given access. */
+		pass& reads(const avk::buffer& aBuffer, stage_flags aStages, access_flags aAccess)
+		{
+			mAccesses.push_back({ aBuffer->handle(), nullptr, false, aStages, aAccess, avk::layout::general });
+			return *this;
+		}
+
+		/** Declares that this pass writes the given buffer in the given stages, with the given access. */
+		pass& writes(const avk::buffer& aBuffer, stage_flags aStages, access_flags aAccess)
+		{
+			mAccesses.push_back({ aBuffer->handle(), nullptr, true, aStages, aAccess, avk::layout::general });
+			return *this;
+		}
+
+		/** Declares that this pass reads the transient image with the given name (in GENERAL layout). */
+		pass& reads_transient(std::string aName, stage_flags aStages, access_flags aAccess)
+		{
+			mAccesses.push_back({ std::move(aName), nullptr, false, aStages, aAccess, avk::layout::general });
+			return *this;
+		}
+
+		/** Declares that this pass writes the transient image with the given name (in GENERAL layout). */
+		pass& writes_transient(std::string aName, stage_flags aStages, access_flags aAccess)
+		{
+			mAccesses.push_back({ std::move(aName), nullptr, true, aStages, aAccess, avk::layout::general });
+			return *this;
+		}
+
+		/** Sets the function which records this pass' commands. Barriers for the declared accesses are recorded before it is invoked. */
+		pass& records(std::function<void(avk::command_buffer_t&)> aRecordFunction)
+		{
+			mRecordFunction = std::move(aRecordFunction);
+			return *this;
+		}
+
+		/** Lets this pass be executed on the async compute queue, if the frame graph has been configured with one (see config_async_compute). */
+		pass& on_async_compute_queue(bool aEnabled = true)
+		{
+			mAsyncCompute = aEnabled;
+			return *this;
+		}
+
+	private:
+		std::string mName;
+		std::vector<resource_access> mAccesses;
+		std::function<void(avk::command_buffer_t&)> mRecordFunction;
+		bool mAsyncCompute = false;
+	};
+
+	/** An image or buffer which is not owned by the frame graph, but accessed by its passes */
+	class imported_resource
+	{
+		friend class frame_graph;
+	public:
+		/** Declares which stages and accesses have written the resource before the frame graph is executed. */
+		imported_resource& produced_by(stage_flags aStages, access_flags aAccess)
+		{
+			mState.mWriteStages = aStages;
+			mState.mWriteAccess = aAccess;
+			return *this;
+		}
+
+		/** Declares which stages and accesses use the resource after the frame graph has been executed. This makes it an output of the frame graph. */
+		imported_resource& consumed_by(stage_flags aStages, access_flags aAccess)
+		{
+			mConsumerStages = aStages;
+			mConsumerAccess = aAccess;
+			mIsOutput = true;
+			return *this;
+		}
+
+		/** Declares the resource as an output of the frame graph without a specific consumer, e.g., because the next frame reads it again. */
+		imported_resource& as_output()
+		{
+			mIsOutput = true;
+			return *this;
+		}
+
+	private:
+		const avk::image_t* mImage = nullptr;
+		// The layout which the resource is expected in outside of the frame graph:
+		avk::layout::image_layout mExternalLayout = avk::layout::general;
+		stage_flags mConsumerStages = avk::stage::none;
+		access_flags mConsumerAccess = avk::access::none;
+		bool mIsOutput = false;
+		bool mAccessed = false;
+		resource_state mState;
+	};
+
+	frame_graph() : invokee("Frame Graph", true)
+	{ }
+
+	// Execution order of 90 => execute after all the post processing effects have declared their passes, but before transfer_to_swapchain
+	int execution_order() const override { return 90; }
+
+	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
+	 *	@param	aQueue				Stores an avk::queue* internally for future use, which has been created previously.
+	 *	@param	aSubmissionBatcher	The recorded command buffer is handed over to it every frame, instead of being submitted directly.
+	 */
+	void config(avk::queue& aQueue, submission_batcher& aSubmissionBatcher)
+	{
+		mQueue = &aQueue;
+		mSubmissionBatcher = &aSubmissionBatcher;
+	}
+
+	/**	Enables executing passes on a second queue. It must be of the same queue family as the queue passed to config(),
+	 *	s.t. all resources can be accessed from both queues without transferring their queue family ownership, but it
+	 *	must be a different VkQueue: waiting for a value which is only signalled later on the same queue would deadlock.
+	 *	@param	aAsyncComputeQueue	The queue, which passes that have been added with on_async_compute_queue() are submitted to.
+	 */
+	void config_async_compute(avk::queue& aAsyncComputeQueue)
+	{
+		if (aAsyncComputeQueue.family_index() != mQueue->family_index()) {
+			LOG_WARNING("The async compute queue is of a different queue family than the graphics queue => all passes are executed on the graphics queue.");
+			return;
+		}
+		if (aAsyncComputeQueue.handle() == mQueue->handle()) {
+			LOG_WARNING("The async compute queue is the same VkQueue as the graphics queue (e.g., because its queue family only provides one queue) => all passes are executed on the graphics queue.");
+			return;
+		}
+		mAsyncComputeQueue = &aAsyncComputeQueue;
+	}
+
+	void initialize() override
+	{
+		// Create a command pool for allocating single-use (hence, transient) command buffers:
+		// (Since both queues are of the same queue family, it serves the async compute queue, too.)
+		mCommandPool = avk::context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient);
+
+		if (nullptr != mAsyncComputeQueue) {
+			// Create the timeline semaphore, which both queues signal and wait on with increasing values:
+			auto semaphoreTypeInfo = vk::SemaphoreTypeCreateInfo{ vk::SemaphoreType::eTimeline, 0 };
+			mTimelineSemaphore = avk::context().device().createSemaphoreUnique(vk::SemaphoreCreateInfo{}.setPNext(&semaphoreTypeInfo));
+		}
+	}
+
+	void finalize() override
+	{
+		mTimelineSemaphore.reset();
+	}
+
+	/**	Declares how an image, which is not owned by the frame graph, is used outside of it during the current frame.
+	 *	Images which are accessed by passes without having been imported are assumed to be kept in GENERAL layout,
+	 *	and to have been written by compute shaders or transfer operations before.
+	 *	@param	aImageView	The image which is accessed by passes of the frame graph
+	 *	@param	aLayout		The layout the image is in before the frame graph is executed, and which it is restored to afterwards
+	 */
+	imported_resource& import_image(const avk::image_view& aImageView, avk::layout::image_layout aLayout = avk::layout::general)
+	{
+		auto& imported = import_resource(aImageView->get_image().handle(), &aImageView->get_image());
+		imported.mExternalLayout = aLayout;
+		imported.mState.mLayout = aLayout;
+		return imported;
+	}
+
+	/**	Declares how a buffer, which is not owned by the frame graph, is used outside of it during the current frame.
+	 *	@param	aBuffer		The buffer which is accessed by passes of the frame graph
+	 */
+	imported_resource& import_buffer(const avk::buffer& aBuffer)
+	{
+		return import_resource(aBuffer->handle(), nullptr);
+	}
+
+	/**	Declares a transient image for the current frame. Its contents are only valid from the first to the last pass which
+	 *	accesses it; transient images whose lifetimes do not overlap can share the same image.
+	 *	@param	aName		Name, by which passes refer to the transient image
+	 *	@param	aTemplate	The transient image is created with the same properties as this image view (and kept in GENERAL layout)
+	 */
+	void declare_transient_image(std::string aName, avk::image_view& aTemplate)
+	{
+		mTransientImageTemplates[std::move(aName)] = &aTemplate;
+	}
+
+	/**	Returns the image view which has been assigned to the transient image with the given name.
+	 *	This is only valid while the passes are being recorded.
+	 */
+	avk::image_view& transient_image(const std::string& aName)
+	{
+		return mTransientImages[mTransientImageAssignments.at(aName)].mImageView;
+	}
+
+	/**	Adds a pass to the current frame. Passes are executed in the order they have been added.
+	 *	@param	aName		A name, describing the pass
+	 */
+	pass& add_pass(std::string aName)
+	{
+		auto& p = mPasses.emplace_back();
+		p.mName = std::move(aName);
+		return p;
+	}
+
+	// Statistics of the last frame, intended to be displayed in the UI:
+	size_t num_passes() const { return mNumPasses; }
+	size_t num_culled_passes() const { return mNumCulledPasses; }
+	size_t num_barriers() const { return mNumBarriers; }
+	size_t num_transient_images() const { return mNumTransientImages; }
+	size_t num_transient_image_allocations() const { return mTransientImages.size(); }
+	size_t num_async_compute_passes() const { return mNumAsyncComputePasses; }
+	size_t num_async_compute_submissions() const { return mNumAsyncComputeSubmissions; }
+	bool has_async_compute_queue() const { return nullptr != mAsyncComputeQueue; }
+
+	/**	Returns the timeline semaphore which is signaled on the async compute queue, and the value
+	 *	which it is signaled with after the last async pass of the previous frame (0 if there has been none yet).
+	 *	Work on the graphics queue which overwrites resources read by async passes must wait on it.
+	 */
+	vk::Semaphore timeline_semaphore() const { return mTimelineSemaphore.get(); }
+	uint64_t last_async_compute_value() const { return mLastAsyncComputeValue; }
+
+	// Cull, assign the transient images, and record all passes which have been added during this frame into one command buffer per queue segment:
+	void render() override
+	{
+		using namespace avk;
+
+		const auto passes = cull_passes();
+		assign_transient_images(passes);
+
+		// Split the passes into segments of consecutive passes, which are executed on the same queue:
+		struct segment { size_t mBegin, mEnd; bool mAsync; };
+		std::vector<segment> segments;
+		for (size_t i = 0; i < passes.size(); ++i) {
+			const bool async = nullptr != mAsyncComputeQueue && passes[i]->mAsyncCompute;
+			if (segments.empty() || segments.back().mAsync != async) {
+				segments.push_back({ i, i, async });
+			}
+			segments.back().mEnd = i + 1;
+		}
+		// The consumers of the imported resources are on the graphics queue => the last segment must be executed there:
+		if (segments.empty() || segments.back().mAsync) {
+			segments.push_back({ passes.size(), passes.size(), false });
+		}
+		const auto firstAsync = std::find_if(std::begin(segments), std::end(segments), [](const segment& s) { return s.mAsync; });
+		const auto lastAsync = std::find_if(std::rbegin(segments), std::rend(segments), [](const segment& s) { return s.mAsync; });
+
+		mNumBarriers = 0;
+		mNumAsyncComputePasses = 0;
+		mNumAsyncComputeSubmissions = 0;
+		const auto inFlightIndex = context().main_window()->in_flight_index_for_frame();
+		for (const auto& seg : segments) {
+			const bool isFirstAsync = std::end(segments) != firstAsync && &seg == &*firstAsync;
+			const bool isLastAsync = std::rend(segments) != lastAsync && &seg == &*lastAsync;
+			auto cmdBfr = mCommandPool->alloc_command_buffer(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+			context().record({
+				command::custom_commands([&, this](avk::command_buffer_t& cb) {
+					if (isFirstAsync) {
+						helpers::record_timing_interval_start(cb.handle(), std::format("async compute {}", inFlightIndex));
+					}
+					for (size_t i = seg.mBegin; i < seg.mEnd; ++i) {
+						record_barriers_before(*passes[i], cb);
+						if (passes[i]->mRecordFunction) {
+							passes[i]->mRecordFunction(cb);
+						}
+					}
+					if (isLastAsync) {
+						helpers::record_timing_interval_end(cb.handle(), std::format("async compute {}", inFlightIndex));
+					}
+					if (&seg == &segments.back()) {
+						record_barriers_for_consumers(cb);
+					}
+				})
+			})
+			.into_command_buffer(cmdBfr);
+
+			if (seg.mAsync) {
+				// Everything which has been added to the submission batcher so far (in particular the scene pass) must have completed
+				// before the async passes start => let the current batch signal the timeline semaphore, and start a new one:
+				const auto waitValue = ++mTimelineValue;
+				mSubmissionBatcher->add_signal(*mTimelineSemaphore, vk::PipelineStageFlagBits2KHR::eAllCommands, waitValue);
+				mSubmissionBatcher->begin_batch();
+				mLastAsyncComputeValue = ++mTimelineValue;
+
+				// Timeline semaphores allow to submit this wait before the batcher submits the corresponding signal operation:
+				const auto waitInfo = vk::SemaphoreSubmitInfoKHR{ *mTimelineSemaphore, waitValue, vk::PipelineStageFlagBits2KHR::eAllCommands };
+				const auto cmdBfrInfo = vk::CommandBufferSubmitInfoKHR{ cmdBfr->handle() };
+				const auto signalInfo = vk::SemaphoreSubmitInfoKHR{ *mTimelineSemaphore, mLastAsyncComputeValue, vk::PipelineStageFlagBits2KHR::eAllCommands };
+				mAsyncComputeQueue->handle().submit2KHR(vk::SubmitInfo2KHR{}
+					.setWaitSemaphoreInfos(waitInfo)
+					.setCommandBufferInfos(cmdBfrInfo)
+					.setSignalSemaphoreInfos(signalInfo));
+
+				// The last segment on the graphics queue waits for this submission, hence it has completed when the frame's fence is signaled:
+				context().main_window()->handle_lifetime(std::move(cmdBfr));
+				mNumAsyncComputePasses += seg.mEnd - seg.mBegin;
+				++mNumAsyncComputeSubmissions;
+			}
+			else {
+				if (mLastAwaitedAsyncComputeValue < mLastAsyncComputeValue) {
+					// Wait for the async passes in all stages, s.t. the barriers recorded for the following passes chain with this wait:
+					mSubmissionBatcher->begin_batch();
+					mSubmissionBatcher->add_wait(*mTimelineSemaphore, vk::PipelineStageFlagBits2KHR::eAllCommands, mLastAsyncComputeValue);
+					mLastAwaitedAsyncComputeValue = mLastAsyncComputeValue;
+				}
+				// The submission batcher submits it together with the other command buffers of this frame, and takes care of its lifetime:
+				mSubmissionBatcher->add(std::move(cmdBfr));
+			}
+		}
+
+		// Passes, imported resources, and transient images are declared anew every frame:
+		mPasses.clear();
+		mImportedResources.clear();
+		mTransientImageTemplates.clear();
+		mTransientImageAssignments.clear();
+	}
+
+private:
+	imported_resource& import_resource(resource_key aKey, const avk::image_t* aImage)
+	{
+		auto& imported = mImportedResources[std::move(aKey)];
+		imported.mImage = aImage;
+		// Unless specified otherwise, assume that the resource has been written by compute shaders or transfer operations:
+		imported.mState.mWriteStages = avk::stage::compute_shader | avk::stage::transfer;
+		imported.mState.mWriteAccess = avk::access::shader_storage_write | avk::access::transfer_write;
+		return imported;
+	}
+
+	/** Returns the synchronization state of the resource which the given access refers to */
+	resource_state& state_of(const resource_access& aAccess)
+	{
+		if (auto* name = std::get_if<std::string>(&aAccess.mKey)) {
+			// Transient images which share the same image also share its state:
+			return mTransientImages[mTransientImageAssignments.at(*name)].mState;
+		}
+		auto it = mImportedResources.find(aAccess.mKey);
+		if (mImportedResources.end() == it) {
+			import_resource(aAccess.mKey, aAccess.mImage);
+			it = mImportedResources.find(aAccess.mKey);
+		}
+		it->second.mAccessed = true;
+		return it->second.mState;
+	}
+
+	/** Returns all passes which contribute to an output of the frame graph (in execution order), and culls all the others */
+	std::vector<pass*> cull_passes()
+	{
+		std::set<resource_key> neededResources;
+		for (const auto& [key, imported] : mImportedResources) {
+			if (imported.mIsOutput) {
+				neededResources.insert(key);
+			}
+		}
+
+		// Walk backwards: A pass is needed if it writes a needed resource, then everything it reads is needed, too:
+		std::vector<pass*> neededPasses;
+		for (auto it = mPasses.rbegin(); it != mPasses.rend(); ++it) {
+			const bool isNeeded = std::any_of(std::begin(it->mAccesses), std::end(it->mAccesses), [&neededResources](const resource_access& a) {
+				return a.mIsWrite && neededResources.contains(a.mKey);
+			});
+			if (!isNeeded) {
+				continue;
+			}
+			for (const auto& a : it->mAccesses) {
+				if (!a.mIsWrite) {
+					neededResources.insert(a.mKey);
+				}
+			}
+			neededPasses.push_back(&*it);
+		}
+		std::reverse(std::begin(neededPasses), std::end(neededPasses));
+
+		mNumPasses = mPasses.size();
+		mNumCulledPasses = mPasses.size() - neededPasses.size();
+		return neededPasses;
+	}
+
+	/** Assigns an image to every transient image which is accessed by the given passes, reusing images whose previous transient image is no longer accessed */
+	void assign_transient_images(const std::vector<pass*>& aPasses)
+	{
+		using namespace avk;
+
+		// Release the images which have not been used during the previous frame (e.g., after a resize, or if an effect has been disabled):
+		for (auto it = mTransientImages.begin(); it != mTransientImages.end();) {
+			if (!it->mUsedThisFrame) {
+				context().main_window()->handle_lifetime(std::move(it->mImageView));
+				it = mTransientImages.erase(it);
+			}
+			else {
+				it->mUsedThisFrame = false;
+				++it;
+			}
+		}
+
+		// Determine the lifetime of each transient image, i.e., the indices of the first and the last pass which access it:
+		std::vector<std::tuple<std::string, size_t, size_t>> lifetimes;
+		for (size_t i = 0; i < aPasses.size(); ++i) {
+			for (const auto& a : aPasses[i]->mAccesses) {
+				const auto* name = std::get_if<std::string>(&a.mKey);
+				if (nullptr == name) {
+					continue;
+				}
+				auto it = std::find_if(std::begin(lifetimes), std::end(lifetimes), [name](const auto& l) { return std::get<0>(l) == *name; });
+				if (std::end(lifetimes) == it) {
+					lifetimes.emplace_back(*name, i, i);
+				}
+				else {
+					std::get<2>(*it) = i;
+				}
+			}
+		}
+		mNumTransientImages = lifetimes.size();
+
+		// lifetimes is sorted by first use => hand out images whose last use lies before the first use of the next transient image:
+		for (const auto& [name, firstUse, lastUse] : lifetimes) {
+			auto& tpl = *mTransientImageTemplates.at(name);
+			auto it = std::find_if(std::begin(mTransientImages), std::end(mTransientImages), [&tpl, firstUse](const transient_image& t) {
+				return (!t.mUsedThisFrame || t.mLastUse < firstUse) && is_compatible(t.mImageView->get_image(), tpl->get_image());
+			});
+			if (std::end(mTransientImages) == it) {
+				auto& created = mTransientImages.emplace_back();
+				created.mImageView = context().create_image_view_from_template(tpl.get());
+				auto fen = context().record_and_submit_with_fence(command::gather(
+					// Transition the new image into GENERAL layout and keep it in that layout forever:
+					sync::image_memory_barrier(created.mImageView->get_image(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+				), *mQueue);
+				fen->wait_until_signalled();
+				it = std::prev(std::end(mTransientImages));
+			}
+			it->mUsedThisFrame = true;
+			it->mLastUse = lastUse;
+			mTransientImageAssignments[name] = static_cast<size_t>(std::distance(std::begin(mTransientImages), it));
+		}
+
+		for (auto* p : aPasses) {
+			for (auto& a : p->mAccesses) {
+				if (const auto* name = std::get_if<std::string>(&a.mKey)) {
+					a.mImage = &transient_image(*name)->get_image();
+				}
+			}
+		}
+	}
+
+	/** Records the barriers which resolve the hazards between the given pass' accesses and all previous accesses to the same resources */
+	void record_barriers_before(pass& aPass, avk::command_buffer_t& cb)
+	{
+		using namespace avk;
+
+		// All hazards which do not require a layout transition are resolved with one global memory barrier:
+		stage_flags srcStages = stage::none, dstStages = stage::none;
+		access_flags srcAccess = access::none, dstAccess = access::none;
+
+		for (const auto& a : aPass.mAccesses) {
+			auto& state = state_of(a);
+			const bool layoutTransition = nullptr != a.mImage && a.mLayout.mLayout != state.mLayout.mLayout;
+
+			if (a.mIsWrite || layoutTransition) {
+				// Write-after-write and write-after-read hazards (a layout transition is a write, too):
+				const auto waitForStages = state.mWriteStages | state.mReadStages;
+				if (layoutTransition) {
+					cb.record(sync::image_memory_barrier(*a.mImage,
+						waitForStages     >> a.mStages,
+						state.mWriteAccess >> a.mAccess
+					).with_layout_transition(state.mLayout >> a.mLayout));
+					++mNumBarriers;
+				}
+				else if (waitForStages.mFlags) {
+					srcStages = srcStages | waitForStages;
+					srcAccess = srcAccess | state.mWriteAccess;
+					dstStages = dstStages | a.mStages;
+					dstAccess = dstAccess | a.mAccess;
+				}
+				state.mLayout = a.mLayout;
+				state.mWriteStages = a.mStages;
+				state.mWriteAccess = a.mIsWrite ? a.mAccess : access::none;
+				state.mVisibleStages = a.mIsWrite ? stage::none : a.mStages;
+				state.mVisibleAccess = a.mIsWrite ? access::none : a.mAccess;
+				state.mReadStages = a.mIsWrite ? stage::none : a.mStages;
+			}
+			else {
+				// Read-after-write hazard, unless the last write has already been made visible to this kind of access:
+				if (state.mWriteStages.mFlags && ((a.mStages.mFlags & ~state.mVisibleStages.mFlags) || (a.mAccess.mFlags & ~state.mVisibleAccess.mFlags))) {
+					srcStages = srcStages | state.mWriteStages;
+					srcAccess = srcAccess | state.mWriteAccess;
+					dstStages = dstStages | a.mStages;
+					dstAccess = dstAccess | a.mAccess;
+					state.mVisibleStages = state.mVisibleStages | a.mStages;
+					state.mVisibleAccess = state.mVisibleAccess | a.mAccess;
+				}
+				state.mReadStages = state.mReadStages | a.mStages;
+			}
+		}
+
+		if (dstStages.mFlags) {
+			cb.record(sync::global_memory_barrier(srcStages >> dstStages, srcAccess >> dstAccess));
+			++mNumBarriers;
+		}
+	}
+
+	/** Records the barriers which hand the imported resources over to their consumers, and restore their external layouts */
+	void record_barriers_for_consumers(avk::command_buffer_t& cb)
+	{
+		using namespace avk;
+
+		stage_flags srcStages = stage::none, dstStages = stage::none;
+		access_flags srcAccess = access::none, dstAccess = access::none;
+
+		for (auto& [key, imported] : mImportedResources) {
+			if (!imported.mAccessed) {
+				continue;
+			}
+			auto& state = imported.mState;
+			const auto waitForStages = state.mWriteStages | state.mReadStages;
+			if (nullptr != imported.mImage && imported.mExternalLayout.mLayout != state.mLayout.mLayout) {
+				// Without a consumer, subsequent commands must synchronize with the same stages as with the last accesses, which also cover the layout transition:
+				const auto consumerStages = imported.mConsumerStages.mFlags ? imported.mConsumerStages : waitForStages;
+				cb.record(sync::image_memory_barrier(*imported.mImage,
+					waitForStages      >> consumerStages,
+					state.mWriteAccess >> imported.mConsumerAccess
+				).with_layout_transition(state.mLayout >> imported.mExternalLayout));
+				++mNumBarriers;
+			}
+			else if (imported.mConsumerStages.mFlags) {
+				srcStages = srcStages | waitForStages;
+				srcAccess = srcAccess | state.mWriteAccess;
+				dstStages = dstStages | imported.mConsumerStages;
+				dstAccess = dstAccess | imported.mConsumerAccess;
+			}
+		}
+
+		if (dstStages.mFlags) {
+			cb.record(sync::global_memory_barrier(srcStages >> dstStages, srcAccess >> dstAccess));
+			++mNumBarriers;
+		}
+	}
+
+	/** Two images can be used for the same transient image if they have been created with the same properties */
+	static bool is_compatible(const avk::image_t& aFirst, const avk::image_t& aSecond)
+	{
+		const auto& first = aFirst.create_info();
+		const auto& second = aSecond.create_info();
+		return first.format == second.format && first.extent == second.extent && first.mipLevels == second.mipLevels
+			&& first.arrayLayers == second.arrayLayers && first.samples == second.samples && first.usage == second.usage;
+	}
+
+	/** An image which is handed out to transient images */
+	struct transient_image
+	{
+		avk::image_view mImageView;
+		// The state is kept across frames, s.t. reusing the image in the next frame is synchronized, too:
+		resource_state mState;
+		// Index of the last pass (of this frame) which accesses it:
+		size_t mLastUse = 0;
+		bool mUsedThisFrame = true;
+	};
+
+	/** One single queue to submit all the commands to: */
+	avk::queue* mQueue;
+
+	/** Collects the command buffers of all invokees, and submits them at once: */
+	submission_batcher* mSubmissionBatcher;
+
+	/** A second queue of the same queue family, which async passes are submitted to (nullptr if there is none): */
+	avk::queue* mAsyncComputeQueue = nullptr;
+
+	/** Synchronizes the async compute queue with the graphics queue. Its values only ever increase: */
+	vk::UniqueSemaphore mTimelineSemaphore;
+	uint64_t mTimelineValue = 0;
+	// The value signaled after the last async pass, and the last of these values which the graphics queue has waited on:
+	uint64_t mLastAsyncComputeValue = 0;
+	uint64_t mLastAwaitedAsyncComputeValue = 0;
+
+	/** A command pool for allocating (single-use) command buffers from: */
+	avk::command_pool mCommandPool;
+
+	// Passes, imported resources, and transient images of the current frame:
+	std::deque<pass> mPasses;
+	std::map<resource_key, imported_resource> mImportedResources;
+	std::map<std::string, avk::image_view*> mTransientImageTemplates;
+	std::map<std::string, size_t> mTransientImageAssignments;
+
+	// Images which are handed out to the transient images:
+	std::vector<transient_image> mTransientImages;
+
+	// Statistics of the last frame:
+	size_t mNumPasses = 0;
+	size_t mNumCulledPasses = 0;
+	size_t mNumBarriers = 0;
+	size_t mNumTransientImages = 0;
+	size_t mNumAsyncComputePasses = 0;
+	size_t mNumAsyncComputeSubmissions = 0;
+};
@@ -13,6 +13,9 @@
 #include <auto_vk_toolkit.hpp>
 #include <imgui.h>
 #include <random>
+#include <future>
+#include "utils/submission_batcher.hpp"
+#include "utils/light_animations.hpp"
 #include "utils/lights_editor.hpp"
 #include "utils/camera_presets.hpp"
 #include "utils/helper_functions.hpp"
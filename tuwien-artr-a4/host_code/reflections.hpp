@@ -8,8 +8,33 @@ class reflections : public avk::invokee
 		int mMaxSteps;
 		float mStepSize;
 		float mEpsilon;
+		int mHiZ;
+		int mMaxIterations;
+		float mThickness;
+		int mTiled;
+		int mHalfResolution;
+		glm::ivec2 mTracedPixelOffset;
 	};
 
+	struct push_constants_for_resolve {
+		glm::mat4 mViewToHistoryClipMatrix;
+		glm::ivec2 mTracedPixelOffset;
+		float mAlpha;
+		float mDepthSharpness;
+		float mNormalSharpness;
+		float mDepthTolerance;
+		int mHistoryValid;
+		int mTiled;
+	};
+
+	// Size of the screen tiles which are classified as reflective or not (matches the work group size of the compute shaders):
+	static constexpr uint32_t TILE_SIZE = 16u;
+	// The lists of tiles in mReflectiveTilesBuffer: reflective tiles, tiles modified when applying the reflections, unmodified tiles
+	static constexpr uint32_t NUM_TILE_LISTS = 3u;
+	static constexpr uint32_t REFLECTIVE_TILES = 0u;
+	static constexpr uint32_t MODIFIED_TILES = 1u;
+	static constexpr uint32_t UNMODIFIED_TILES = 2u;
+
 public:
 	/**	An invokee which adds ambient occlusion as a post processing effect
 	 */
@@ -22,18 +47,19 @@ public:
 	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
 	 *	@param	aQueue							Stores an avk::queue* internally for future use, which has been created previously.
 	 *	@param	aDescriptorCache				A descriptor cache that shall be used (possibly allowing descriptor re-use from other invokees)
-	 *	@param	aUniformsBuffer					A buffer containing user input and current frame's data
+	 *	@param	aFrameGraph						The frame graph which this invokee's passes are added to every frame
+	 *	@param	aUniformsBuffers				One buffer per frame in flight, containing user input and that frame's data
 	 *	@param	aSourceColor					Rendered results from previous steps where ambient occlusion shall be added,
 	 *											expected to be given in GENERAL layout.
 	 *	@param	aSourceDepth					G-Buffer depth values associated to the color values in aSourceColors
 	 *	@param	aSourceUvNormal					G-Buffer attachment containing UV coordinates in .rg and spherical normals in .ba
 	 *	@param	aSourceMatId					G-Buffer attachment containing the material id
 	 *	@param	aDestinationImageView			Destination image view which shall receive the rendered results after the ambient occlusion effect has been added
-	 *											Expected to be given in THE SAME FORMAT as aIntermediateImage and in GENERAL layout.
+	 *											Expected to be given in GENERAL layout. The reflected values are stored in a transient image of the same format.
 	 *	@param	aMaterialsBuffer				A buffer containing all the materials of the scene
 	 *	@param	aImageSamplerDescriptorInfos	A vector containing all the image samplers that are used/referenced in the data of aMaterialsBuffer
 	 */
-	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, avk::buffer aUniformsBuffer,
+	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, frame_graph& aFrameGraph, std::vector<avk::buffer> aUniformsBuffers,
 		avk::image_view aSourceColor, avk::image_view aSourceDepth, avk::image_view aSourceUvNormal, avk::image_view aSourceMatId,
 		avk::image_view aDestinationImageView,
 		avk::buffer aMaterialsBuffer, std::vector<avk::combined_image_sampler_descriptor_info> aImageSamplerDescriptorInfos)
@@ -42,7 +68,8 @@ public:
 
 		mQueue = &aQueue;
 		mDescriptorCache = std::move(aDescriptorCache);
-		mUniformsBuffer = std::move(aUniformsBuffer);
+		mFrameGraph = &aFrameGraph;
+		mUniformsBuffers = std::move(aUniformsBuffers);
 		mSrcColor = std::move(aSourceColor);
 		mSrcDepth = std::move(aSourceDepth);
 		mSrcUvNrm = std::move(aSourceUvNormal);
@@ -51,28 +78,49 @@ public:
 		mMaterials = std::move(aMaterialsBuffer);
 		mImageSamplerDescriptorInfos = std::move(aImageSamplerDescriptorInfos);
 
-		mIntermediateImage = context().create_image_view_from_template(mDstResults.get());
+		// Create the min-depth (Hi-Z) pyramid, and one image view per level for writing it:
+		const auto w = mSrcDepth->get_image().width();
+		const auto h = mSrcDepth->get_image().height();
+		auto hiZImg = context().create_image(w, h, vk::Format::eR32Sfloat, 1, memory_usage::device, image_usage::general_storage_image | image_usage::mip_mapped);
+		// Create the image which receives one hit point per 2x2 quad in half resolution mode:
+		auto hitPointsImg = context().create_image((w + 1u) / 2u, (h + 1u) / 2u, vk::Format::eR32G32Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		mHiZLevels.clear();
+		for (auto level = 0u; level < hiZImg->create_info().mipLevels; level++) {
+			mHiZLevels.push_back(context().create_image_view(hiZImg, std::nullopt, {}, [&level](avk::image_view_t& aImageView) { aImageView.create_info().subresourceRange.setBaseMipLevel(level).setLevelCount(1u); }));
+		}
+
 		auto fen = context().record_and_submit_with_fence(command::gather(
-			// Transition the storage image into GENERAL layout and keep it in that layout forever:
-			sync::image_memory_barrier(mIntermediateImage->get_image(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+			// Transition the Hi-Z pyramid into GENERAL layout and keep it in that layout forever:
+			sync::image_memory_barrier(hiZImg.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(hitPointsImg.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
 		), *mQueue);
 		fen->wait_until_signalled();
+
+		mHiZ = context().create_image_view(std::move(hiZImg));
+		mHitPoints = context().create_image_view(std::move(hitPointsImg));
+
+		// Create the lists of classified tiles, which start with their arguments for vkCmdDispatchIndirect:
+		const auto numTiles = ((w + TILE_SIZE - 1u) / TILE_SIZE) * ((h + TILE_SIZE - 1u) / TILE_SIZE);
+		mReflectiveTilesBuffer = context().create_buffer(
+			memory_usage::device, { vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndirectBuffer }, // Only written on the device (the dispatch arguments are reset with an update command)
+			storage_buffer_meta::create_from_size(sizeof(glm::uvec4) * NUM_TILE_LISTS + sizeof(uint32_t) * numTiles * NUM_TILE_LISTS)
+		);
 	}
 
 	/**	Method to configure this invokee for ray traced reflections, intended to be invoked BEFORE this invokee's invocation of initialize()
-	 *	@param	aLightsBuffer							A buffer containing light source data
+	 *	@param	aLightsBuffers							One buffer per frame in flight, containing light source data
 	 *	@param	aIndexBufferUniformTexelBufferViews		A vector of descriptors to uniform texel buffers, containing indices data
 	 *	@param	aNormalBufferUniformTexelBufferViews	A vector of descriptors to uniform texel buffers, containing normals data
 	 *	@param	aTopLevelAS								A top level acceleration structure for ray tracing, it shall contain the whole scene
 	 */
 	void config_rtx_on(
-		avk::buffer aLightsBuffer,
+		std::vector<avk::buffer> aLightsBuffers,
 		std::vector<avk::buffer_view_descriptor_info> aIndexBufferUniformTexelBufferViews, std::vector<avk::buffer_view_descriptor_info> aNormalBufferUniformTexelBufferViews,
 		avk::top_level_acceleration_structure aTopLevelAS)
 	{
 		mRtxOn.emplace();
 
-		mLightsBuffer = std::move(aLightsBuffer);
+		mLightsBuffers = std::move(aLightsBuffers);
 		mIndexBufferUniformTexelBufferViews = std::move(aIndexBufferUniformTexelBufferViews);
 		mNormalBufferUniformTexelBufferViews = std::move(aNormalBufferUniformTexelBufferViews);
 		mTopLevelAS = std::move(aTopLevelAS);
@@ -80,6 +128,17 @@ public:
 		// TODO Bonus Task 3 RTX ON: Pass additional required resources and use them!
 		//
 	}
+
+	/**	Replaces the light source data buffer of the given frame in flight, e.g., after it had to grow.
+	 *	@param	aInFlightIndex		The frame in flight which the buffer belongs to
+	 *	@param	aLightsBuffer		The new buffer containing light source data
+	 */
+	void set_lights_buffer(avk::window::frame_id_t aInFlightIndex, avk::buffer aLightsBuffer)
+	{
+		if (aInFlightIndex < mLightsBuffers.size()) {
+			mLightsBuffers[aInFlightIndex] = std::move(aLightsBuffer);
+		}
+	}
 	
 	/**	Returns the result of the GPU timer query, which indicates how long the reflections effect approximately took.
 	 */
@@ -88,19 +147,15 @@ public:
 		if (!mReflectionsEnabled) {
 			return 0.0f;
 		}
-		return helpers::get_timing_interval_in_ms(std::format("reflections {}", mPingPong));
+		return helpers::get_timing_interval_in_ms(std::format("reflections {}", helpers::get_oldest_in_flight_index()));
 	}
 
 	// Create all the compute (and ray-tracing) pipelines used for the post processing effect(s),
-	// prepare some command buffers with pipeline barriers to synchronize with subsequent commands,
 	// create a new ImGui window that allows to enable/disable reflections, and to modify parameters:
 	void initialize() override 
 	{
 		using namespace avk;
 
-		// Create a command pool for allocating single-use (hence, transient) command buffers:
-		mCommandPool = context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient);
-
 		// Use this invokee's updater to enable shader hot reloading
 		mUpdater.emplace();
 
@@ -111,15 +166,59 @@ public:
 			descriptor_binding<image_view_as_sampled_image>(0, 1, 1u),
 			descriptor_binding<image_view_as_sampled_image>(0, 2, 1u),
 			descriptor_binding<image_view_as_sampled_image>(0, 3, 1u),
-			descriptor_binding(1, 0, mUniformsBuffer),
-			descriptor_binding<image_view_as_storage_image>(2, 0, 1u)
+			descriptor_binding<image_view_as_sampled_image>(0, 4, 1u),
+			descriptor_binding(1, 0, mUniformsBuffers[0]), // Doesn't have to be the exact buffer, but one that describes the correct layout for the pipeline.
+			descriptor_binding<image_view_as_storage_image>(2, 0, 1u),
+			descriptor_binding<image_view_as_storage_image>(2, 1, 1u),
+			descriptor_binding(3, 0, mReflectiveTilesBuffer)
 		);
 
 		mUpdater->on(shader_files_changed_event(mGenerateReflectionsPipeline.as_reference()))
 			.update(mGenerateReflectionsPipeline);
 
+		mResolvePipeline = context().create_compute_pipeline_for(
+			"shaders/ssr_resolve.comp",
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(push_constants_for_resolve) },
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding<image_view_as_sampled_image>(1, 0, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 1, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 2, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 3, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 4, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 5, 1u),
+			descriptor_binding<image_view_as_storage_image>(2, 0, 1u),
+			descriptor_binding<image_view_as_storage_image>(2, 1, 1u),
+			descriptor_binding(3, 0, mReflectiveTilesBuffer),
+			descriptor_binding(4, 0, mUniformsBuffers[0])
+		);
+
+		mUpdater->on(shader_files_changed_event(mResolvePipeline.as_reference()))
+			.update(mResolvePipeline);
+
+		mClassifyTilesPipeline = context().create_compute_pipeline_for(
+			"shaders/classify_reflective_tiles.comp",
+			descriptor_binding(0, 0, mMaterials),
+			descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
+			descriptor_binding<image_view_as_sampled_image>(1, 0, 1u),
+			descriptor_binding<image_view_as_sampled_image>(1, 1, 1u),
+			descriptor_binding(2, 0, mReflectiveTilesBuffer)
+		);
+
+		mUpdater->on(shader_files_changed_event(mClassifyTilesPipeline.as_reference()))
+			.update(mClassifyTilesPipeline);
+
+		mHiZPipeline = context().create_compute_pipeline_for(
+			"shaders/hiz_downsample.comp",
+			descriptor_binding<image_view_as_sampled_image>(0, 0, 1u),
+			descriptor_binding<image_view_as_storage_image>(0, 1, 1u)
+		);
+
+		mUpdater->on(shader_files_changed_event(mHiZPipeline.as_reference()))
+			.update(mHiZPipeline);
+
 		mApplyReflectionsPipeline = context().create_compute_pipeline_for(
 			"shaders/apply_reflections.comp",
+			push_constant_binding_data{ shader_type::compute, 0, sizeof(int32_t) },
 			descriptor_binding(0, 0, mMaterials),
 			descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
 			descriptor_binding<image_view_as_sampled_image>(1, 0, 1u),
@@ -127,7 +226,8 @@ public:
 			descriptor_binding<image_view_as_sampled_image>(1, 2, 1u),
 			descriptor_binding<image_view_as_sampled_image>(1, 3, 1u),
 			descriptor_binding<image_view_as_sampled_image>(2, 0, 1u),
-			descriptor_binding<image_view_as_storage_image>(2, 1, 1u)
+			descriptor_binding<image_view_as_storage_image>(2, 1, 1u),
+			descriptor_binding(3, 0, mReflectiveTilesBuffer)
 		);
 
 		mUpdater->on(shader_files_changed_event(mApplyReflectionsPipeline.as_reference()))
@@ -139,13 +239,30 @@ public:
 			imguiManager->add_callback([this](){
 				ImGui::Begin("Reflections Settings");
 				ImGui::SetWindowPos(ImVec2(295.0f, 180.0f), ImGuiCond_FirstUseEver);
-				ImGui::SetWindowSize(ImVec2(220.0f, 115.0f), ImGuiCond_FirstUseEver);
+				ImGui::SetWindowSize(ImVec2(220.0f, 275.0f), ImGuiCond_FirstUseEver);
 				ImGui::Checkbox("enabled", &mReflectionsEnabled);
+				ImGui::SameLine();
+				ImGui::Checkbox("async compute", &mAsyncCompute);
 				static const char* sOcclusionItems[] = { "display reflections", "apply reflections" };
 				ImGui::Combo("apply?", &mApplyReflections, sOcclusionItems, IM_ARRAYSIZE(sOcclusionItems));
+				ImGui::Checkbox("skip non-reflective tiles", &mTileClassification);
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("Classify %ux%u screen tiles by their materials, and only generate reflections for the tiles containing\nreflective pixels, and only apply them to the tiles whose pixels they modify (dispatched indirectly).\nAll other tiles are only copied. Only used when applying them.", TILE_SIZE, TILE_SIZE);
+				}
 				ImGui::SliderInt("max steps", &mMaxSteps, 10, 200);
 				ImGui::SliderFloat("step size", &mStepSize, 0.1, 1);
 				ImGui::SliderFloat("epsilon", &mEpsilon, 0.01, 0.1);
+				static const char* sTracingItems[] = { "linear march", "Hi-Z (linear march as fallback)" };
+				ImGui::Combo("tracing", &mHiZTracing, sTracingItems, IM_ARRAYSIZE(sTracingItems));
+				ImGui::SliderInt("max iterations (Hi-Z)", &mMaxHiZIterations, 8, 256);
+				ImGui::SliderFloat("thickness (Hi-Z)", &mThickness, 0.01f, 2.0f);
+				ImGui::Checkbox("half resolution (temporal)", &mHalfResolution);
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("Trace one ray per 2x2 quad from a pixel which changes every frame, and resolve them to full resolution\nby reusing the hits of neighbouring quads on the same surface and accumulating them over time.");
+				}
+				ImGui::SliderFloat("temporal alpha", &mResolveAlpha, 0.01f, 1.0f);
+				ImGui::SliderFloat("resolve depth sharpness", &mResolveDepthSharpness, 0.0f, 100.0f);
+				ImGui::SliderFloat("resolve normal sharpness", &mResolveNormalSharpness, 0.0f, 64.0f);
 				if (mRtxOn.has_value()) {
 					static const char* sRtxOffOn[] = { "RTX OFF (use Screen Space Reflections)", "RTX ON" };
 					ImGui::Combo("type", &mRtxOn.value(), sRtxOffOn, IM_ARRAYSIZE(sRtxOffOn));
@@ -161,8 +278,8 @@ public:
 		if (mTopLevelAS.has_value()) {
 
 			// If any of these asserts fails: Have you passed everything properly to config_rtx_on()?
-			assert(mUniformsBuffer.has_value());
-			assert(mLightsBuffer.has_value());
+			assert(!mUniformsBuffers.empty());
+			assert(!mLightsBuffers.empty());
 			assert(!mIndexBufferUniformTexelBufferViews.empty());
 			assert(!mNormalBufferUniformTexelBufferViews.empty());
 
@@ -184,8 +301,8 @@ public:
 				max_recursion_depth::disable_recursion(), // No need for recursions
 				descriptor_binding(0, 0, mMaterials),
 				descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
-				descriptor_binding(1, 0, mUniformsBuffer),
-				descriptor_binding(1, 1, mLightsBuffer),
+				descriptor_binding(1, 0, mUniformsBuffers[0]),
+				descriptor_binding(1, 1, mLightsBuffers[0]),
 				descriptor_binding<image_view_as_sampled_image>(2, 0, 1u),
 				descriptor_binding<image_view_as_sampled_image>(2, 1, 1u),
 				descriptor_binding<image_view_as_sampled_image>(2, 2, 1u),
@@ -212,149 +329,363 @@ public:
 		mPushConstants.mMaxSteps = mMaxSteps;
 		mPushConstants.mStepSize = mStepSize;
 		mPushConstants.mEpsilon = mEpsilon;
+		mPushConstants.mHiZ = mHiZTracing;
+		mPushConstants.mMaxIterations = mMaxHiZIterations;
+		mPushConstants.mThickness = mThickness;
 	}
 
-	// Create a new command buffer every frame, record instructions into it, and submit it to the graphics queue:
+	// Add this frame's passes to the frame graph, which derives the barriers between them from their declared accesses:
 	void render() override 
 	{
 		using namespace avk;
 
-		auto cmdBfr = mCommandPool->alloc_command_buffer(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-		context().record(command::gather( // Record a bunch of commands (which can be a mix of state-type commands and action-type commands):
+		if (!mReflectionsEnabled) {
+			mFrameGraph->add_pass("reflections: copy")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcColor, stage::copy, access::transfer_read)
+				.writes(mDstResults, stage::copy, access::transfer_write)
+				.records([this](avk::command_buffer_t& cb) {
+					cb.record(copy_image_to_another(mSrcColor->get_image(), layout::general, mDstResults->get_image(), layout::general));
+				});
+			return;
+		}
 
-			command::conditional([this] { return mReflectionsEnabled; },
-				[this] { return command::custom_commands([this](avk::command_buffer_t& cb) {
+		const auto inFlightIndex = context().main_window()->in_flight_index_for_frame();
+		const auto frameId = context().main_window()->current_frame();
+		mFrameGraph->declare_transient_image("reflections", mDstResults);
+
+		const bool tiled = tile_classification_active();
+		const bool halfRes = 0 == mRtxOn.value_or(0) && mHalfResolution;
+		// In half resolution mode, all quads are traced (the tiles are only used by the full resolution passes):
+		mPushConstants.mTiled = tiled && !halfRes ? 1 : 0;
+		mPushConstants.mHalfResolution = halfRes ? 1 : 0;
+		// Rotate the traced pixel of every quad through all four of its pixels:
+		static constexpr std::array<glm::ivec2, 4> sTracedPixelOffsets = { glm::ivec2{ 0, 0 }, glm::ivec2{ 1, 1 }, glm::ivec2{ 1, 0 }, glm::ivec2{ 0, 1 } };
+		mPushConstants.mTracedPixelOffset = sTracedPixelOffsets[frameId % sTracedPixelOffsets.size()];
+		if (tiled) {
+			// ------> 0th step: Collect the tiles which contain reflective or otherwise modified pixels, s.t. the following passes can skip all the others
+			mFrameGraph->add_pass("reflections: classify tiles")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcMatId, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcUvNrm, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.writes(mReflectiveTilesBuffer, stage::transfer | stage::compute_shader, access::transfer_write | access::shader_storage_write)
+				.records([this, inFlightIndex](avk::command_buffer_t& cb) {
+					helpers::record_timing_interval_start(cb.handle(), std::format("reflections {}", inFlightIndex));
+
+					const auto w = mSrcMatId->get_image().width();
+					const auto h = mSrcMatId->get_image().height();
+					// Reset the dispatch arguments of all lists to (0 tiles, 1, 1):
+					std::array<glm::uvec4, NUM_TILE_LISTS> initialDispatchArgs;
+					initialDispatchArgs.fill(glm::uvec4{ 0u, 1u, 1u, 0u });
+					cb.handle().updateBuffer(mReflectiveTilesBuffer->handle(), 0, sizeof(initialDispatchArgs), initialDispatchArgs.data());
+					cb.record(sync::global_memory_barrier(stage::transfer >> stage::compute_shader, access::transfer_write >> access::shader_storage_read | access::shader_storage_write));
+					cb.record(avk::command::bind_pipeline(mClassifyTilesPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mClassifyTilesPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mMaterials),
+						descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
+						descriptor_binding(1, 0, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(2, 0, mReflectiveTilesBuffer)
+					})));
+					cb.handle().dispatch((w + TILE_SIZE - 1u) / TILE_SIZE, (h + TILE_SIZE - 1u) / TILE_SIZE, 1);
+				});
+		}
 
-					mPingPong = 1 - mPingPong;
-					helpers::record_timing_interval_start(cb.handle(), std::format("reflections {}", mPingPong));
+		const bool hiZ = 0 == mRtxOn.value_or(0) && 1 == mHiZTracing;
+		if (hiZ) {
+			// ------> 0th step: Build the min-depth pyramid, level by level
+			mFrameGraph->add_pass("reflections: hi-z pyramid")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcDepth, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.writes(mHiZ, stage::compute_shader, access::shader_storage_write)
+				.records([this, inFlightIndex, tiled](avk::command_buffer_t& cb) {
+					if (!tiled) {
+						helpers::record_timing_interval_start(cb.handle(), std::format("reflections {}", inFlightIndex));
+					}
 
-					const auto w = mDstResults->get_image().width();
-					const auto h = mDstResults->get_image().height();
-					cb.record(sync::global_memory_barrier(stage::color_attachment_output >> stage::compute_shader, 
-					                                      access::color_attachment_write >> access::shader_sampled_read));
-
-					// ------> 1st step: Generate reflections
-					if (0 == mRtxOn.value_or(0)) {
-						// =================  vvv   SSR   vvv  ================
-						// Generate reflections using screen space reflections:
-						cb.record(avk::command::bind_pipeline(mGenerateReflectionsPipeline.as_reference()));
-						cb.record(avk::command::bind_descriptors(mGenerateReflectionsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-							descriptor_binding(0, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(0, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(0, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(0, 3, mSrcColor->as_sampled_image(layout::general)),
-							descriptor_binding(1, 0, mUniformsBuffer),
-							descriptor_binding(2, 0, mIntermediateImage->as_storage_image(layout::general)) 
+					cb.record(avk::command::bind_pipeline(mHiZPipeline.as_reference()));
+					for (size_t level = 0; level < mHiZLevels.size(); level++) {
+						const auto w = std::max(1u, mSrcDepth->get_image().width() >> level);
+						const auto h = std::max(1u, mSrcDepth->get_image().height() >> level);
+						cb.record(avk::command::bind_descriptors(mHiZPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+							0 == level
+								? descriptor_binding(0, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal))
+								: descriptor_binding(0, 0, mHiZLevels[level - 1]->as_sampled_image(layout::general)),
+							descriptor_binding(0, 1, mHiZLevels[level]->as_storage_image(layout::general))
 						})));
-						cb.record(avk::command::push_constants(mGenerateReflectionsPipeline->layout(), mPushConstants));
 						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
-						// =================  ^^^   SSR   ^^^  ================
+						// The next level reads this one:
+						cb.record(sync::global_memory_barrier(
+							stage::compute_shader        >> stage::compute_shader,
+							access::shader_storage_write >> access::shader_read
+						));
+					}
+				});
+		}
+
+		// ------> 1st step: Generate reflections
+		const auto generateStages = 1 == mRtxOn.value_or(0) ? stage::ray_tracing_shader : stage::compute_shader;
+		auto& generatePass = mFrameGraph->add_pass("reflections: generate")
+			.on_async_compute_queue(mAsyncCompute)
+			.reads(mSrcDepth, generateStages, access::shader_sampled_read, layout::shader_read_only_optimal)
+			.reads(mSrcUvNrm, generateStages, access::shader_sampled_read, layout::shader_read_only_optimal)
+			.reads(mSrcMatId, generateStages, access::shader_sampled_read, layout::shader_read_only_optimal)
+			.reads(mSrcColor, generateStages, access::shader_sampled_read);
+		if (halfRes) {
+			generatePass.writes(mHitPoints, stage::compute_shader, access::shader_storage_write);
+		}
+		else {
+			generatePass.writes_transient("reflections", generateStages, access::shader_storage_write);
+		}
+		if (hiZ) {
+			generatePass.reads(mHiZ, stage::compute_shader, access::shader_sampled_read);
+		}
+		if (tiled && !halfRes) {
+			generatePass.reads(mReflectiveTilesBuffer, stage::draw_indirect | stage::compute_shader, access::indirect_command_read | access::shader_storage_read);
+		}
+		generatePass
+			.records([this, inFlightIndex, hiZ, tiled, halfRes](avk::command_buffer_t& cb) {
+
+				if (!hiZ && !tiled) {
+					helpers::record_timing_interval_start(cb.handle(), std::format("reflections {}", inFlightIndex));
+				}
+
+				const auto w = mDstResults->get_image().width();
+				const auto h = mDstResults->get_image().height();
+				auto& reflectedValues = mFrameGraph->transient_image("reflections");
+
+				if (0 == mRtxOn.value_or(0)) {
+					// =================  vvv   SSR   vvv  ================
+					// Generate reflections using screen space reflections:
+					cb.record(avk::command::bind_pipeline(mGenerateReflectionsPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mGenerateReflectionsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(0, 3, mSrcColor->as_sampled_image(layout::general)),
+						descriptor_binding(0, 4, mHiZ->as_sampled_image(layout::general)),
+						descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
+						descriptor_binding(2, 0, reflectedValues->as_storage_image(layout::general)),
+						descriptor_binding(2, 1, mHitPoints->as_storage_image(layout::general)),
+						descriptor_binding(3, 0, mReflectiveTilesBuffer)
+					})));
+					cb.record(avk::command::push_constants(mGenerateReflectionsPipeline->layout(), mPushConstants));
+					if (halfRes) {
+						// One invocation per quad:
+						cb.handle().dispatch((mHitPoints->get_image().width() + 15u) / 16u, (mHitPoints->get_image().height() + 15u) / 16u, 1);
+					}
+					else if (tiled) {
+						// One work group per reflective tile:
+						cb.handle().dispatchIndirect(mReflectiveTilesBuffer->handle(), sizeof(glm::uvec4) * REFLECTIVE_TILES);
 					}
 					else {
-						// =================  vvv  RTX ON  vvv  ================
-						// Generate reflections using ray tracing (if it has been enabled in assignment4.cpp):
-						if (mRayTracingPipeline.has_value()) {
-							cb.record(avk::command::bind_pipeline(mRayTracingPipeline.as_reference()));
-							cb.record(avk::command::bind_descriptors(mRayTracingPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
-								descriptor_binding(0, 0, mMaterials),
-								descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
-								descriptor_binding(1, 0, mUniformsBuffer),
-								descriptor_binding(1, 1, mLightsBuffer),
-								descriptor_binding(2, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
-								descriptor_binding(2, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
-								descriptor_binding(2, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
-								descriptor_binding(2, 3, mSrcColor->as_sampled_image(layout::general)),
-								descriptor_binding(3, 0, mIntermediateImage->as_storage_image(layout::general)),
-								descriptor_binding(4, 0, mIndexBufferUniformTexelBufferViews),
-								descriptor_binding(4, 1, mNormalBufferUniformTexelBufferViews),
-								//
-								// TODO Bonus Task 3 RTX ON: Pass additional resources to the ray tracing pipeline!
-								//
-								descriptor_binding(5, 0, mTopLevelAS)
-							})));
-							cb.record(avk::command::trace_rays(
-								vk::Extent3D{ w, h, 1u },
-								mRayTracingPipeline->shader_binding_table(),
-								avk::using_raygen_group_at_index(0),
-								avk::using_miss_group_at_index(0),
-								avk::using_hit_group_at_index(0)
-							));
-						}
-						else {
-							LOG_ERROR("mRayTracingPipeline has not been created. Cannot use it.");
-						}
-						// =================  ^^^  RTX ON  ^^^  ================
+						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
 					}
-
-					auto srcStages = 1 == mRtxOn.value_or(0) ? stage::ray_tracing_shader : stage::compute_shader;
-					if (1 == mApplyReflections) {
-						// ------> 2nd step: Apply the reflections
-						cb.record(sync::image_memory_barrier(mIntermediateImage->get_image(),
-							// We have to wait for previous operation that wrote reflections into mIntermediateImage before using it in a compute shader:
-							srcStages                      >>   stage::compute_shader,
-							// Writes to the image must be made available and visible to reads in the subsequent compute shader:
-							access::shader_storage_write   >>   access::shader_read
-						));
-						
-						cb.record(avk::command::bind_pipeline(mApplyReflectionsPipeline.as_reference()));
-						cb.record(avk::command::bind_descriptors(mApplyReflectionsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+					// =================  ^^^   SSR   ^^^  ================
+				}
+				else {
+					// =================  vvv  RTX ON  vvv  ================
+					// Generate reflections using ray tracing (if it has been enabled in assignment4.cpp):
+					if (mRayTracingPipeline.has_value()) {
+						cb.record(avk::command::bind_pipeline(mRayTracingPipeline.as_reference()));
+						cb.record(avk::command::bind_descriptors(mRayTracingPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
 							descriptor_binding(0, 0, mMaterials),
 							descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
-							descriptor_binding(1, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(1, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(1, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
-							descriptor_binding(1, 3, mSrcColor->as_sampled_image(layout::general)),
-							descriptor_binding(2, 0, mIntermediateImage->as_sampled_image(layout::general)),
-							descriptor_binding(2, 1, mDstResults->as_storage_image(layout::general))
+							descriptor_binding(1, 0, mUniformsBuffers[inFlightIndex]),
+							descriptor_binding(1, 1, mLightsBuffers[inFlightIndex]),
+							descriptor_binding(2, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+							descriptor_binding(2, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+							descriptor_binding(2, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
+							descriptor_binding(2, 3, mSrcColor->as_sampled_image(layout::general)),
+							descriptor_binding(3, 0, reflectedValues->as_storage_image(layout::general)),
+							descriptor_binding(4, 0, mIndexBufferUniformTexelBufferViews),
+							descriptor_binding(4, 1, mNormalBufferUniformTexelBufferViews),
+							//
+							// TODO Bonus Task 3 RTX ON: Pass additional resources to the ray tracing pipeline!
+							//
+							descriptor_binding(5, 0, mTopLevelAS)
 						})));
+						cb.record(avk::command::trace_rays(
+							vk::Extent3D{ w, h, 1u },
+							mRayTracingPipeline->shader_binding_table(),
+							avk::using_raygen_group_at_index(0),
+							avk::using_miss_group_at_index(0),
+							avk::using_hit_group_at_index(0)
+						));
+					}
+					else {
+						LOG_ERROR("mRayTracingPipeline has not been created. Cannot use it.");
+					}
+					// =================  ^^^  RTX ON  ^^^  ================
+				}
+			});
+
+		if (halfRes) {
+			// ------> 1st step (continued): Resolve the hits of the quads to full resolution, and blend them with the reprojected history
+			const auto w = mDstResults->get_image().width();
+			const auto h = mDstResults->get_image().height();
+			if (mHistory.empty() || mHistory[0]->get_image().width() != w || mHistory[0]->get_image().height() != h) {
+				create_history_images(w, h);
+			}
+
+			auto* camera = current_composition()->element_by_type<quake_camera>();
+			const auto viewProjMatrix = camera->projection_matrix() * camera->view_matrix();
+			mResolvePushConstants.mViewToHistoryClipMatrix = mHistoryViewProjMatrix * glm::inverse(camera->view_matrix());
+			mResolvePushConstants.mTracedPixelOffset = mPushConstants.mTracedPixelOffset;
+			mResolvePushConstants.mAlpha = mResolveAlpha;
+			mResolvePushConstants.mDepthSharpness = mResolveDepthSharpness;
+			mResolvePushConstants.mNormalSharpness = mResolveNormalSharpness;
+			mResolvePushConstants.mDepthTolerance = mResolveDepthTolerance;
+			mResolvePushConstants.mHistoryValid = mHistoryFrameId == frameId - 1 ? 1 : 0;
+			mResolvePushConstants.mTiled = tiled ? 1 : 0;
+
+			// The history images are used alternately, s.t. one is read while the other one is written:
+			auto& srcHistory = mHistory[(frameId + 1) % 2];
+			auto& dstHistory = mHistory[frameId % 2];
+			auto& resolvePass = mFrameGraph->add_pass("reflections: resolve")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcDepth, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcUvNrm, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcMatId, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcColor, stage::compute_shader, access::shader_sampled_read)
+				.reads(mHitPoints, stage::compute_shader, access::shader_sampled_read)
+				.reads(srcHistory, stage::compute_shader, access::shader_sampled_read)
+				.writes_transient("reflections", stage::compute_shader, access::shader_storage_write)
+				.writes(dstHistory, stage::compute_shader, access::shader_storage_write);
+			if (tiled) {
+				resolvePass.reads(mReflectiveTilesBuffer, stage::draw_indirect | stage::compute_shader, access::indirect_command_read | access::shader_storage_read);
+			}
+			resolvePass
+				.records([this, inFlightIndex, tiled, &srcHistory, &dstHistory](avk::command_buffer_t& cb) {
+					const auto w = mDstResults->get_image().width();
+					const auto h = mDstResults->get_image().height();
+					cb.record(avk::command::bind_pipeline(mResolvePipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mResolvePipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mMaterials),
+						descriptor_binding(1, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 3, mSrcColor->as_sampled_image(layout::general)),
+						descriptor_binding(1, 4, mHitPoints->as_sampled_image(layout::general)),
+						descriptor_binding(1, 5, srcHistory->as_sampled_image(layout::general)),
+						descriptor_binding(2, 0, mFrameGraph->transient_image("reflections")->as_storage_image(layout::general)),
+						descriptor_binding(2, 1, dstHistory->as_storage_image(layout::general)),
+						descriptor_binding(3, 0, mReflectiveTilesBuffer),
+						descriptor_binding(4, 0, mUniformsBuffers[inFlightIndex])
+					})));
+					cb.record(avk::command::push_constants(mResolvePipeline->layout(), mResolvePushConstants));
+					if (tiled) {
+						cb.handle().dispatchIndirect(mReflectiveTilesBuffer->handle(), sizeof(glm::uvec4) * REFLECTIVE_TILES);
+					}
+					else {
 						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
 					}
+				});
+
+			mHistoryFrameId = frameId;
+			mHistoryViewProjMatrix = viewProjMatrix;
+		}
+
+		if (1 == mApplyReflections) {
+			// ------> 2nd step: Apply the reflections
+			auto& applyPass = mFrameGraph->add_pass("reflections: apply")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads(mSrcDepth, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcUvNrm, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcMatId, stage::compute_shader, access::shader_sampled_read, layout::shader_read_only_optimal)
+				.reads(mSrcColor, stage::compute_shader, access::shader_sampled_read)
+				.reads_transient("reflections", stage::compute_shader, access::shader_sampled_read)
+				.writes(mDstResults, stage::compute_shader, access::shader_storage_write);
+			if (tiled) {
+				applyPass.reads(mReflectiveTilesBuffer, stage::draw_indirect | stage::compute_shader, access::indirect_command_read | access::shader_storage_read);
+			}
+			applyPass
+				.records([this, inFlightIndex, tiled](avk::command_buffer_t& cb) {
+					const auto w = mDstResults->get_image().width();
+					const auto h = mDstResults->get_image().height();
+					cb.record(avk::command::bind_pipeline(mApplyReflectionsPipeline.as_reference()));
+					cb.record(avk::command::bind_descriptors(mApplyReflectionsPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
+						descriptor_binding(0, 0, mMaterials),
+						descriptor_binding(0, 1, mImageSamplerDescriptorInfos),
+						descriptor_binding(1, 0, mSrcDepth->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 1, mSrcUvNrm->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 2, mSrcMatId->as_sampled_image(layout::shader_read_only_optimal)),
+						descriptor_binding(1, 3, mSrcColor->as_sampled_image(layout::general)),
+						descriptor_binding(2, 0, mFrameGraph->transient_image("reflections")->as_sampled_image(layout::general)),
+						descriptor_binding(2, 1, mDstResults->as_storage_image(layout::general)),
+						descriptor_binding(3, 0, mReflectiveTilesBuffer)
+					})));
+					if (tiled) {
+						// Apply the reflections to the tiles they modify, and only copy the remaining tiles (both write disjoint pixels):
+						for (const int32_t tileList : { static_cast<int32_t>(MODIFIED_TILES), static_cast<int32_t>(UNMODIFIED_TILES) }) {
+							cb.record(avk::command::push_constants(mApplyReflectionsPipeline->layout(), tileList));
+							cb.handle().dispatchIndirect(mReflectiveTilesBuffer->handle(), sizeof(glm::uvec4) * tileList);
+						}
+					}
 					else {
-						// ------> Alternative 2nd step: For debug purposes, display the reflected values instead of applying them to the input image
-						cb.record(sync::image_memory_barrier(mIntermediateImage->get_image(),
-							// We have to wait for previous operation that wrote reflections into mIntermediateImage before using it in the transfer operation:
-							srcStages                     >>  stage::copy,
-							// Writes to the image must be made available and visible to reads of the transfer operation:
-							access::shader_storage_write  >>  access::transfer_read
-						));
-						cb.record(copy_image_to_another(mIntermediateImage->get_image(), layout::general, mDstResults->get_image(), layout::general));
+						const int32_t tiledFlag = 0;
+						cb.record(avk::command::push_constants(mApplyReflectionsPipeline->layout(), tiledFlag));
+						cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
 					}
 
-					helpers::record_timing_interval_end(cb.handle(), std::format("reflections {}", mPingPong));
-				}); },
-				[this] { 
-					return copy_image_to_another(mSrcColor->get_image(), layout::general, mDstResults->get_image(), layout::general); 
-				}
-			),
-			
-			// In any case, sync with subsequent compute or transfer commands:
-			sync::global_memory_barrier(
-				// Compute or transfer operations must complete before other compute or transfer operations may proceed:
-				stage::compute_shader | stage::transfer               >> stage::compute_shader | stage::transfer,
-				// Particularly write accesses must be made available, and we just assume here that next access for resources will be read:
-				access::shader_storage_write | access::transfer_write >> access::shader_read | access::transfer_read
-			)
-		)) // End of command recording
-		.into_command_buffer(cmdBfr)
-		.then_submit_to(*mQueue)
-		.submit();
-
-		// Use a convenience function of avk::window to take care of the command buffer's lifetime:
-		// It will get deleted in the future after #concurrent-frames have passed by.
-		context().main_window()->handle_lifetime(std::move(cmdBfr));
+					helpers::record_timing_interval_end(cb.handle(), std::format("reflections {}", inFlightIndex));
+				});
+		}
+		else {
+			// ------> Alternative 2nd step: For debug purposes, display the reflected values instead of applying them to the input image
+			mFrameGraph->add_pass("reflections: display")
+				.on_async_compute_queue(mAsyncCompute)
+				.reads_transient("reflections", stage::copy, access::transfer_read)
+				.writes(mDstResults, stage::copy, access::transfer_write)
+				.records([this, inFlightIndex](avk::command_buffer_t& cb) {
+					cb.record(copy_image_to_another(mFrameGraph->transient_image("reflections")->get_image(), layout::general, mDstResults->get_image(), layout::general));
+
+					helpers::record_timing_interval_end(cb.handle(), std::format("reflections {}", inFlightIndex));
+				});
+		}
 	}
 	
 private:
+	/** Tile classification only pays off when the reflections are applied (the debug display shows all of them): */
+	bool tile_classification_active() const
+	{
+		return mTileClassification && 1 == mApplyReflections;
+	}
+
+	/**	Creates the two images which the resolved reflections of half resolution mode are accumulated in (alternately)
+	 *	@param	aWidth		Width of the history images
+	 *	@param	aHeight		Height of the history images
+	 */
+	void create_history_images(uint32_t aWidth, uint32_t aHeight)
+	{
+		using namespace avk;
+
+		for (auto& history : mHistory) {
+			context().main_window()->handle_lifetime(std::move(history));
+		}
+		mHistory.clear();
+
+		auto historyA = context().create_image(aWidth, aHeight, vk::Format::eR16G16B16A16Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto historyB = context().create_image(aWidth, aHeight, vk::Format::eR16G16B16A16Sfloat, 1, memory_usage::device, image_usage::general_storage_image);
+		auto fen = context().record_and_submit_with_fence(command::gather(
+			sync::image_memory_barrier(historyA.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general),
+			sync::image_memory_barrier(historyB.as_reference(), stage::none >> stage::none).with_layout_transition(layout::undefined >> layout::general)
+		), *mQueue);
+		fen->wait_until_signalled();
+
+		mHistory.push_back(context().create_image_view(std::move(historyA)));
+		mHistory.push_back(context().create_image_view(std::move(historyB)));
+		mHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
+	}
+
 	/** One single queue to submit all the commands to: */
 	avk::queue* mQueue;
 
 	/** One descriptor cache to use for allocating all the descriptor sets from: */
 	avk::descriptor_cache mDescriptorCache;
 
-	/** A command pool for allocating (single-use) command buffers from: */
-	avk::command_pool mCommandPool;
-
-	int mPingPong{ 1 };
+	/** The frame graph which all passes are added to: */
+	frame_graph* mFrameGraph;
 
 	// Source image views:
 	avk::image_view mSrcDepth;
@@ -363,30 +694,57 @@ private:
 	avk::image_view mSrcColor;
 	// Destination image view:
 	avk::image_view mDstResults;
-	// Images for intermediate results:
-	avk::image_view mIntermediateImage;
 	// Buffer containing all the different materials as loaded from 3D models/ORCA scenes:
 	avk::buffer mMaterials;
 	// Set of image samplers which are referenced by the materials in mMaterials:
 	std::vector<avk::combined_image_sampler_descriptor_info> mImageSamplerDescriptorInfos;
-	// Buffer containing the user input and matrices:
-	avk::buffer mUniformsBuffer;
-	// Buffer containing the light source data:
-	avk::buffer mLightsBuffer;
+	// Buffers containing the user input and matrices, one per frame in flight:
+	std::vector<avk::buffer> mUniformsBuffers;
+	// Buffers containing the light source data, one per frame in flight:
+	std::vector<avk::buffer> mLightsBuffers;
 	
 	// Settings, which can be modified via ImGui:
 	bool mReflectionsEnabled = true;
+	bool mAsyncCompute = false;
 	int mApplyReflections = 1;
 	std::optional<int> mRtxOn;
 
 	int mMaxSteps = 100;
 	float mStepSize = 0.1;
 	float mEpsilon = 0.05;
+	int mHiZTracing = 1;
+	int mMaxHiZIterations = 64;
+	float mThickness = 0.5f;
+	bool mTileClassification = true;
+	bool mHalfResolution = false;
+	float mResolveAlpha = 0.2f;
+	float mResolveDepthSharpness = 20.0f;
+	float mResolveNormalSharpness = 8.0f;
+	float mResolveDepthTolerance = 0.05f;
 
 	push_constants_data mPushConstants;
 
 	avk::compute_pipeline mGenerateReflectionsPipeline;
 
+	// Min-depth pyramid of mSrcDepth (for Hi-Z tracing), one image view per level, and the pipeline which builds it:
+	avk::image_view mHiZ;
+	std::vector<avk::image_view> mHiZLevels;
+	avk::compute_pipeline mHiZPipeline;
+
+	// Dispatch arguments followed by the list of tiles which contain reflective pixels, and the pipeline which fills it:
+	avk::buffer mReflectiveTilesBuffer;
+	avk::compute_pipeline mClassifyTilesPipeline;
+
+	// Half resolution mode: one hit point per 2x2 quad, the pipeline which resolves them to full resolution,
+	// and the two history images which the resolved reflections are accumulated in (the previous frame's one is
+	// mHistory[(frameId + 1) % 2]), together with the frame and the camera they have been rendered with:
+	avk::image_view mHitPoints;
+	avk::compute_pipeline mResolvePipeline;
+	push_constants_for_resolve mResolvePushConstants;
+	std::vector<avk::image_view> mHistory;
+	avk::window::frame_id_t mHistoryFrameId = std::numeric_limits<avk::window::frame_id_t>::max();
+	glm::mat4 mHistoryViewProjMatrix{ 1.0f };
+
 	avk::top_level_acceleration_structure mTopLevelAS;
 	std::vector<avk::buffer_view_descriptor_info> mIndexBufferUniformTexelBufferViews;
 	std::vector<avk::buffer_view_descriptor_info> mNormalBufferUniformTexelBufferViews;
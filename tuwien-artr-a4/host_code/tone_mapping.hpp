@@ -28,18 +28,20 @@ public:
 	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
 	 *	@param	aQueue				Stores an avk::queue* internally for future use, which has been created previously.
 	 *	@param	aDescriptorCache	A descriptor cache that shall be used (possibly allowing descriptor re-use from other invokees)
+	 *	@param	aFrameGraph			The frame graph which this invokee's passes are added to every frame
 	 *	@param	aSourceHdr			Input image in HDR format which contains the results to be tone mapped.
 	 *	                            The image's layout is expected to be GENERAL.
 	 *	@param	aDestinationLdr		Destination image which shall receive the LDR color values after tone mapping.
 	 *	                            The image's layout is expected to be GENERAL.
 	 */
-	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, 
+	void config(avk::queue& aQueue, avk::descriptor_cache aDescriptorCache, frame_graph& aFrameGraph,
 		avk::image_view aSourceHdr, avk::image_view aDestinationLdr)
 	{
 		using namespace avk;
 
 		mQueue = &aQueue;
 		mDescriptorCache = std::move(aDescriptorCache);
+		mFrameGraph = &aFrameGraph;
 		mSourceHdr = std::move(aSourceHdr);
 		mDestinationLdr = std::move(aDestinationLdr);
 
@@ -67,19 +69,15 @@ public:
 	 */
 	float duration()
 	{
-		return helpers::get_timing_interval_in_ms(std::format("tone mapping {}", mPingPong));
+		return helpers::get_timing_interval_in_ms(std::format("tone mapping {}", helpers::get_oldest_in_flight_index()));
 	}
 
 	// Create all the compute pipelines used for the post processing effect(s),
-	// prepare some command buffers with pipeline barriers to synchronize with subsequent commands,
 	// create a new ImGui window that allows to enable/disable tone mapping, and to modify parameters:
 	void initialize() override 
 	{
 		using namespace avk;
 
-		// Create a command pool for allocating single-use (hence, transient) command buffers:
-		mCommandPool = context().create_command_pool(mQueue->family_index(), vk::CommandPoolCreateFlagBits::eTransient);
-
 		constexpr auto initialLumData = lum_data{ 1.0f, 10.0f, glm::vec2{0.0f, 0.0f} };
 		mLumBuffer = context().create_buffer(
 			memory_usage::device, {},
@@ -165,6 +163,8 @@ public:
 				ImGui::SetWindowPos(ImVec2(295.0f, 305.0f), ImGuiCond_FirstUseEver);
 				ImGui::SetWindowSize(ImVec2(220.0f, 134.0f), ImGuiCond_FirstUseEver);
 				ImGui::Checkbox("enabled", &mToneMappingEnabled);
+				ImGui::SameLine();
+				ImGui::Checkbox("async compute", &mAsyncCompute);
 				ImGui::Checkbox("gradual", &mGradualAdaption);
 				ImGui::SliderFloat("speed", &mAdaptionSpeed, 0.1f, 10.0f);
 				ImGui::Checkbox("use max", &mUseMax);
@@ -191,20 +191,31 @@ public:
 		mPushConstants.mAdaptionSpeed	   = mAdaptionSpeed;
 	}
 
-	// Create a new command buffer every frame, record instructions into it, and submit it to the graphics queue:
+	// Add this frame's passes to the frame graph, which derives the barriers between them from their declared accesses:
 	void render() override 
 	{
 		using namespace avk;
 
-		auto cmdBfr = mCommandPool->alloc_command_buffer(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-		context().record({ // Record a bunch of commands (which can be a mix of state-type commands and action-type commands):
+		const auto inFlightIndex = context().main_window()->in_flight_index_for_frame();
+
+		// The luminance buffer is read again in the next frame (for the gradual adaption):
+		mFrameGraph->import_buffer(mLumBuffer)
+			.produced_by(stage::compute_shader, access::shader_storage_write)
+			.as_output();
 
-			command::custom_commands([this](avk::command_buffer_t& cb) {
+		// Note: mToneMappingEnabled is evaluated in shader code!
 
-				// Note: mToneMappingEnabled is evaluated in shader code!
+		// Compute the average and maximum luminance, and update the luminance buffer:
+		mFrameGraph->add_pass("tone mapping: luminance")
+			.on_async_compute_queue(mAsyncCompute)
+			.reads(mSourceHdr, stage::compute_shader, access::shader_sampled_read)
+			.writes(mAvgLogLumLevels.front(), stage::compute_shader | stage::transfer, access::shader_storage_write | access::transfer_write)
+			.writes(mMaxLogLumLevels.front(), stage::compute_shader, access::shader_storage_write)
+			.reads(mLumBuffer, stage::compute_shader, access::shader_storage_read)
+			.writes(mLumBuffer, stage::compute_shader, access::shader_storage_write)
+			.records([this, inFlightIndex](avk::command_buffer_t& cb) {
 
-				mPingPong = 1 - mPingPong;
-				helpers::record_timing_interval_start(cb.handle(), std::format("tone mapping {}", mPingPong));
+				helpers::record_timing_interval_start(cb.handle(), std::format("tone mapping {}", inFlightIndex));
 
 				const auto w = mDestinationLdr->get_image().width();
 				const auto h = mDestinationLdr->get_image().height();
@@ -260,9 +271,18 @@ public:
 					descriptor_binding(1, 0, mLumBuffer)
 				})));
 				cb.record(avk::command::push_constants(mUpdateLumBufferPipeline->layout(), mPushConstants));
-				dispatch_and_sync_with_subsequent_compute(1u, 1u, cb); // will dispatch one group - local_size = 1 instead of 16 doesn't matter
+				cb.handle().dispatch(1u, 1u, 1u); // will dispatch one group - local_size = 1 instead of 16 doesn't matter
+			});
 
-				// Invoke the tone mapping shader (compute shader):
+		// Invoke the tone mapping shader (compute shader):
+		mFrameGraph->add_pass("tone mapping: apply")
+			.on_async_compute_queue(mAsyncCompute)
+			.reads(mSourceHdr, stage::compute_shader, access::shader_sampled_read)
+			.reads(mLumBuffer, stage::compute_shader, access::shader_storage_read)
+			.writes(mDestinationLdr, stage::compute_shader, access::shader_storage_write)
+			.records([this, inFlightIndex](avk::command_buffer_t& cb) {
+				const auto w = mDestinationLdr->get_image().width();
+				const auto h = mDestinationLdr->get_image().height();
 				cb.record(avk::command::bind_pipeline(mToneMappingPipeline.as_reference()));
 				cb.record(avk::command::bind_descriptors(mToneMappingPipeline->layout(), mDescriptorCache->get_or_create_descriptor_sets({
 					descriptor_binding(0, 0, mSourceHdr->as_sampled_image(layout::general)),
@@ -272,24 +292,8 @@ public:
 				cb.record(avk::command::push_constants(mToneMappingPipeline->layout(), mPushConstants));
 				cb.handle().dispatch((w + 15u) / 16u, (h + 15u) / 16u, 1);
 
-				helpers::record_timing_interval_end(cb.handle(), std::format("tone mapping {}", mPingPong));
-
-				// Finally, sync with subsequent compute or transfer commands:
-				cb.record(sync::global_memory_barrier(
-					// Compute must complete before other compute or transfer operations may proceed:
-					stage::compute_shader        >> stage::compute_shader | stage::transfer,
-					// Particularly write accesses must be made available, and we just assume here that next access for resources will be read:
-					access::shader_storage_write >> access::shader_read | access::transfer_read
-				));
-			}),
-		}) // End of command recording
-		.into_command_buffer(cmdBfr)
-			.then_submit_to(*mQueue)
-			.submit();
-
-		// Use a convenience function of avk::window to take care of the command buffer's lifetime:
-		// It will get deleted in the future after #concurrent-frames have passed by.
-		context().main_window()->handle_lifetime(std::move(cmdBfr));
+				helpers::record_timing_interval_end(cb.handle(), std::format("tone mapping {}", inFlightIndex));
+			});
 	}
 
 
@@ -307,6 +311,7 @@ private:
 
 	// Settings which can be modified via ImGui:
 	bool mToneMappingEnabled = true;
+	bool mAsyncCompute = false;
 	bool mGradualAdaption = true;
 	bool mUseMax = true;
 	float mKey = 0.18f;
@@ -318,10 +323,8 @@ private:
 	/** One descriptor cache to use for allocating all the descriptor sets from: */
 	avk::descriptor_cache mDescriptorCache;
 
-	/** A command pool for allocating (single-use) command buffers from: */
-	avk::command_pool mCommandPool;
-
-	int mPingPong{ 1 };
+	/** The frame graph which all passes are added to: */
+	frame_graph* mFrameGraph;
 
 	/** Source/input image view in HDR: */
 	avk::image_view mSourceHdr;
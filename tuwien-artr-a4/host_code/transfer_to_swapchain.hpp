@@ -16,6 +16,7 @@ public:
 
 	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
 	 *	@param	aQueue				Stores an avk::queue* internally for future use, which has been created previously.
+	 *	@param	aSubmissionBatcher	The command buffer for the current swap chain image is handed over to it every frame, instead of being submitted directly.
 	 *	@param	aSourceDepth		Depth image that shall be transferred to the swap chain's depth image.
 	 *	@param	aDepthTransferType	Indicates by which operation (copy or blit) the transfer of the depth image shall happen.
 	 *	@param	aDepthImageLayouts	Describes in which layout the depth image comes in, and which layout it shall be transitioned into after the transfer operation.
@@ -23,7 +24,7 @@ public:
 	 *	@param	aColorTransferType	Indicates by which operation (copy or blit) the transfer of the color image shall happen.
 	 *	@param	aColorImageLayouts	Describes in which layout the color image comes in, and which layout it shall be transitioned into after the transfer operation.
 	 */
-	void config(avk::queue& aQueue,
+	void config(avk::queue& aQueue, submission_batcher& aSubmissionBatcher,
 		avk::image_view aSourceDepth, transfer_type aDepthTransferType, avk::layout::image_layout_transition aDepthImageLayouts,
 		avk::image_view aSourceColor, transfer_type aColorTransferType, avk::layout::image_layout_transition aColorImageLayouts,
 		std::optional<std::tuple<avk::image_view, transfer_type, avk::layout::image_layout_transition>> aIntermediateColorImage = {}
@@ -32,6 +33,7 @@ public:
 		using namespace avk;
 
 		mQueue = &aQueue;
+		mSubmissionBatcher = &aSubmissionBatcher;
 		mSrcDepth = std::move(aSourceDepth);
 		mDepthTransferType = aDepthTransferType;
 		mDepthImageLayouts = aDepthImageLayouts;
@@ -59,11 +61,11 @@ public:
 		});
 	}
 
-	// Create a new command buffer every frame, record instructions into it, and submit it to the graphics queue:
+	// Hand the (reusable) command buffer for the current swap chain image over to the submission batcher:
 	void render() override 
 	{
 		using namespace avk;
-		mQueue->submit(mCommandBuffers[context().main_window()->current_image_index()].as_reference());
+		mSubmissionBatcher->add(mCommandBuffers[context().main_window()->current_image_index()].as_reference());
 	}
 
 private:
@@ -230,6 +232,7 @@ private:
 
 private:
 	avk::queue* mQueue;
+	submission_batcher* mSubmissionBatcher;
 	avk::command_pool mCommandPool;
 	std::vector<avk::command_buffer> mCommandBuffers;
 
@@ -10,6 +10,7 @@
 #include "cubic_uniform_b_spline.hpp"
 #include "orbit_camera.hpp"
 #include "quadratic_uniform_b_spline.hpp"
+#include "submission_batcher.hpp"
 
 // TODO! light gizmos and path rendering will probably break if main uses a different renderpass setup!
 
@@ -230,6 +231,11 @@ public:
 	bool is_gui_enabled() { return mGuiEnabled; }
 	void set_gui_enabled(bool aEnabled) { mGuiEnabled = aEnabled; }
 
+	/**	If set, the command buffers are handed over to the given submission batcher instead of being submitted directly.
+	 *	@param	aSubmissionBatcher	Submits all command buffers of a frame at once, or nullptr to submit directly
+	 */
+	void set_submission_batcher(submission_batcher* aSubmissionBatcher) { mSubmissionBatcher = aSubmissionBatcher; }
+
 	void initialize() override
 	{
 		init_gui();
@@ -362,6 +368,14 @@ public:
 
 		// SUBMIT, and establish necessary sync:
 		auto mainWnd = avk::context().main_window();
+		if (nullptr != mSubmissionBatcher) {
+			// The batcher submits it together with the other command buffers of this frame, and takes care of its lifetime:
+			if (!mainWnd->has_consumed_current_image_available_semaphore()) {
+				mSubmissionBatcher->add_wait(mainWnd->consume_current_image_available_semaphore()->handle(), vk::PipelineStageFlagBits2KHR::eEarlyFragmentTests);
+			}
+			mSubmissionBatcher->add(std::move(cmdBfr));
+			return;
+		}
 		auto submission = mQueue->submit(cmdBfr.as_reference());
 
 		// If this is the first render call, then consume the image available semaphore:
@@ -896,6 +910,7 @@ private:
 
 	avk::queue* mQueue;
 	avk::command_pool mCommandPool;
+	submission_batcher* mSubmissionBatcher = nullptr;
 	avk::graphics_pipeline mPipelineVisPath1, mPipelineVisPath2;
 	std::vector<avk::buffer> mVertexBufferVisPath1, mVertexBufferVisPath2;
 
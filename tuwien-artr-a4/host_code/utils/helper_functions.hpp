@@ -80,12 +80,21 @@ namespace helpers
 	}
 
 
+	/** Determines whether the meshes of the model with the given name are to be tessellated and displaced.
+	 *	Used when setting up the materials as well as for sorting the draw calls onto the matching G-Buffer pipeline.
+	 *	@param	aModelName	The name of the model (as given in the scene file).
+	 */
+	static bool is_to_be_tessellated(const std::string& aModelName)
+	{
+		return std::string::npos != aModelName.find("terrain") || std::string::npos != aModelName.find("debris");
+	}
+
 	// We're only going to tessellate terrain materials. Set the tessellation factor for those to 1.
 	// Indicate that the other materials shall not be tessellated/displaced with a tessellation factor of 0.
 	static void enable_tessellation_for_specific_meshes(avk::orca_scene_t& aScene)
 	{
 		for (auto& model : aScene.models()) {
-			const bool isToBeTessellated = std::string::npos != model.mName.find("terrain") || std::string::npos != model.mName.find("debris");
+			const bool isToBeTessellated = is_to_be_tessellated(model.mName);
 			auto meshIndices = model.mLoadedModel->select_all_meshes();
 			for (auto i : meshIndices) {
 				auto m = model.mLoadedModel->material_config_for_mesh(i);
@@ -552,33 +561,50 @@ namespace helpers
 		return sLightsources;
 	}
 
-	static void animate_lights(std::vector<avk::lightsource>& aLightsources, float aElapsedTime)
+	// get the animations of the light sources returned by get_lights()
+	// - the light sources are looked up by their names only once, afterwards they are referred to by their indices
+	static light_animations& get_light_animations()
 	{
-		{
-			const auto it = std::find_if(std::begin(aLightsources), std::end(aLightsources), [](const avk::lightsource& ls) { return "pointlight near walkthrough" == ls.mName; });
-			if (std::end(aLightsources) != it) {
-				const auto speedXZ = 0.5f;
-				const auto radiusXZ = 1.5f;
-				it->mPosition = glm::vec3{-0.64f, 0.45f, 3.35f} + glm::vec3(radiusXZ * glm::sin(speedXZ * aElapsedTime), 0.0f, radiusXZ * glm::cos(speedXZ * aElapsedTime));
+		static light_animations sAnimations = [](){
+			light_animations anis;
+			auto& ls = get_lights();
+			auto find = [&ls](const std::string& aName) {
+				const auto it = std::find_if(std::begin(ls), std::end(ls), [&aName](const avk::lightsource& l) { return aName == l.mName; });
+				return std::end(ls) != it ? std::optional<light_animations::handle>{ static_cast<light_animations::handle>(std::distance(std::begin(ls), it)) } : std::nullopt;
+			};
+			if (auto h = find("pointlight near walkthrough")) {
+				anis.add_orbit(*h, glm::vec3{-0.64f, 0.45f, 3.35f}, 1.5f, 0.5f);
 			}
-		}
-		{
-			const auto it = std::find_if(std::begin(aLightsources), std::end(aLightsources), [](const avk::lightsource& ls) { return "pointlight near parallelepiped" == ls.mName; });
-			if (std::end(aLightsources) != it) {
-				const auto kSpeed = 0.6f;
-				const auto kDistanceX = -0.23f;
-				const auto kDistanceY = 1.0f;
-				it->mPosition = glm::vec3{-0.05f, 2.12f, 0.53f} + glm::vec3(kDistanceX * glm::sin(kSpeed * aElapsedTime), kDistanceY * glm::sin(kSpeed * aElapsedTime), 0.0f);
+			if (auto h = find("pointlight near parallelepiped")) {
+				anis.add(*h, glm::vec3{-0.05f, 2.12f, 0.53f}, glm::vec3{-0.23f, 1.0f, 0.0f}, glm::vec3{0.0f}, 0.6f);
 			}
-		}
-		{
-			const auto it = std::find_if(std::begin(aLightsources), std::end(aLightsources), [](const avk::lightsource& ls) { return "pointlight outside above terrain" == ls.mName; });
-			if (std::end(aLightsources) != it) {
-				const auto speedXZ = 0.75f;
-				const auto radiusXZ = 4.0f;
-				it->mPosition = glm::vec3{-2.0f, 1.45f, 17.0f} + glm::vec3(radiusXZ * glm::sin(speedXZ * aElapsedTime), 0.0f, radiusXZ * glm::cos(speedXZ * aElapsedTime));
+			if (auto h = find("pointlight outside above terrain")) {
+				anis.add_orbit(*h, glm::vec3{-2.0f, 1.45f, 17.0f}, 4.0f, 0.75f);
 			}
-		}
+			// let the extra point lights (see lightsource_limits.h) circle along their ring, s.t. stress tests have lots of moving lights:
+			// - get_lights() creates them consecutively in the order of their indices => only look up the first one by its name
+			constexpr float dAngle = glm::two_pi<float>() / std::max(1, EXTRA_POINTLIGHTS);
+			if (auto first = EXTRA_POINTLIGHTS > 0 ? find("extrapointlight[0]") : std::nullopt) {
+				assert(*first + static_cast<size_t>(EXTRA_POINTLIGHTS) <= ls.size());
+				for (int i = 0; i < EXTRA_POINTLIGHTS; ++i) {
+					const auto h = *first + static_cast<light_animations::handle>(i);
+					anis.add_orbit(h, glm::vec3{0.0f, ls[h].mPosition.y, 0.0f}, glm::length(glm::vec2{ ls[h].mPosition.x, ls[h].mPosition.z }), 0.2f, glm::half_pi<float>() - i * dAngle);
+				}
+			}
+			return anis;
+		}();
+		return sAnimations;
+	}
+
+	static void animate_lights(std::vector<avk::lightsource>& aLightsources, float aElapsedTime)
+	{
+		// The handles are indices into get_lights(), which is also the order in which create_lightsource_editor adds them to the editor:
+		auto lightsEd = avk::current_composition()->element_by_type<lights_editor>();
+		get_light_animations().evaluate(aLightsources, aElapsedTime, [lightsEd](light_animations::handle aLight) {
+			if (lightsEd) {
+				lightsEd->mark_modified(static_cast<size_t>(aLight));
+			}
+		});
 	}
 
 	static uint32_t get_lightsource_type_begin_index(std::vector<avk::lightsource>& aLightsources, avk::lightsource_type aLightsourceType)
@@ -609,6 +635,275 @@ namespace helpers
 		return get_lightsource_type_end_index(get_lights(), aLightsourceType);
 	}
 
+	/** Header of the light sources storage buffer, followed by a runtime-sized array of avk::lightsource_gpu_data.
+	 *	Its layout corresponds to the beginning of the LightsourceData buffer block in the shaders (std430).
+	 */
+	struct lightsource_data_header
+	{
+		// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
+		glm::uvec4 mRangesAmbientDirectional;
+		// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
+		glm::uvec4 mRangesPointSpot;
+		// Number of elements which follow the header
+		uint32_t mNumLightsources;
+		uint32_t mPadding[3];
+	};
+
+	/** Returns the size in bytes of a light sources storage buffer which can hold the given number of light sources. */
+	static size_t get_lights_buffer_size(size_t aCapacity)
+	{
+		return sizeof(lightsource_data_header) + std::max(aCapacity, size_t{ 1 }) * sizeof(avk::lightsource_gpu_data);
+	}
+
+	/** Returns the capacity a light sources storage buffer must have to hold the given number of light sources.
+	 *	If the current capacity does not suffice, it grows geometrically, s.t. steadily adding lights only rarely requires a new buffer.
+	 *	@param	aCurrentCapacity		The number of light sources the current buffer can hold
+	 *	@param	aNumLightsources		The number of light sources that shall be stored
+	 */
+	static size_t get_lights_buffer_capacity(size_t aCurrentCapacity, size_t aNumLightsources)
+	{
+		if (aNumLightsources <= aCurrentCapacity) {
+			return aCurrentCapacity;
+		}
+		return std::max(aNumLightsources, aCurrentCapacity + aCurrentCapacity / 2);
+	}
+
+	/** Creates a storage buffer for the given number of light sources.
+	 *	@param	aMemoryUsage			Where the buffer's backing memory shall reside
+	 *	@param	aCapacity				The number of light sources the buffer shall be able to hold
+	 */
+	static avk::buffer create_lights_buffer(avk::memory_usage aMemoryUsage, size_t aCapacity)
+	{
+		return avk::context().create_buffer(aMemoryUsage, {}, avk::storage_buffer_meta::create_from_size(get_lights_buffer_size(aCapacity)));
+	}
+
+	/** Writes the header and the data of the given (sorted) light sources into the given memory,
+	 *	which must be at least get_lights_buffer_size(aLightsources.size()) bytes large.
+	 *	@param	aLightsources			The active light sources, sorted by their types
+	 *	@param	aViewMatrix				The matrix to transform the light sources with
+	 *	@param	aDestination			Where to write to
+	 */
+	static void write_lightsource_data(std::vector<avk::lightsource>& aLightsources, const glm::mat4& aViewMatrix, void* aDestination)
+	{
+		auto* header = static_cast<lightsource_data_header*>(aDestination);
+		header->mRangesAmbientDirectional = glm::uvec4{
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::ambient),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::ambient),
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::directional),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::directional)
+		};
+		header->mRangesPointSpot = glm::uvec4{
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::point),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::point),
+			get_lightsource_type_begin_index(aLightsources, avk::lightsource_type::spot),
+			get_lightsource_type_end_index(aLightsources, avk::lightsource_type::spot)
+		};
+		header->mNumLightsources = static_cast<uint32_t>(aLightsources.size());
+		auto gpuData = avk::convert_for_gpu_usage<std::vector<avk::lightsource_gpu_data>>(aLightsources, aViewMatrix);
+		std::memcpy(header + 1, gpuData.data(), gpuData.size() * sizeof(avk::lightsource_gpu_data));
+	}
+
+	/** Calculates the distance from the given light source, beyond which its intensity (i.e., color / attenuation)
+	 *	drops below the given cutoff intensity (same as in cluster_lights.comp). It is infinite if it is not attenuated with distance.
+	 *	@param	aLightsource			The light source
+	 *	@param	aCutoffIntensity		Intensity below which the light source's contribution is neglected
+	 */
+	static float calc_lightsource_range(const avk::lightsource& aLightsource, float aCutoffIntensity)
+	{
+		// Solve constant + linear * r + quadratic * r^2 = k for r:
+		const float k = glm::max(aLightsource.mColor.r, glm::max(aLightsource.mColor.g, aLightsource.mColor.b)) / aCutoffIntensity;
+		const float c = aLightsource.mAttenuationConstant, l = aLightsource.mAttenuationLinear, q = aLightsource.mAttenuationQuadratic;
+		if (c >= k) {
+			return 0.0f; // never bright enough
+		}
+		if (q > 0.0f) {
+			return (-l + glm::sqrt(l * l - 4.0f * q * (c - k))) / (2.0f * q);
+		}
+		if (l > 0.0f) {
+			return (k - c) / l;
+		}
+		return std::numeric_limits<float>::infinity();
+	}
+
+	/** Calculates a world space bounding sphere of the region which the given light source illuminates with an intensity
+	 *	(i.e., color / attenuation) of at least the given cutoff intensity. For spot lights, it bounds the cone only.
+	 *	Ambient and directional light sources, and those which are not attenuated with distance, affect everything => infinite radius.
+	 *	@param	aLightsource			The light source
+	 *	@param	aCutoffIntensity		Intensity below which the light source's contribution is neglected
+	 *	@return	Center (xyz) and radius (w) of the bounding sphere
+	 */
+	static glm::vec4 calc_lightsource_bounding_sphere(const avk::lightsource& aLightsource, float aCutoffIntensity)
+	{
+		constexpr float infinity = std::numeric_limits<float>::infinity();
+		if (avk::lightsource_type::point != aLightsource.mType && avk::lightsource_type::spot != aLightsource.mType) {
+			return glm::vec4{ aLightsource.mPosition, infinity };
+		}
+
+		const float range = calc_lightsource_range(aLightsource, aCutoffIntensity);
+		if (avk::lightsource_type::point == aLightsource.mType || range == infinity) {
+			return glm::vec4{ aLightsource.mPosition, range };
+		}
+		// Bounding sphere of the cone with its apex at the light's position, its axis along its direction, and the given length:
+		const float halfAngle = glm::min(aLightsource.mAngleOuterCone * 0.5f, glm::pi<float>());
+		const glm::vec3 dir = glm::normalize(aLightsource.mDirection);
+		if (halfAngle > glm::quarter_pi<float>()) {
+			// Wide cones are bounded by the sphere around the center of the cap's base circle (or the whole range sphere, beyond 90 degrees):
+			if (halfAngle >= glm::half_pi<float>()) {
+				return glm::vec4{ aLightsource.mPosition, range };
+			}
+			return glm::vec4{ aLightsource.mPosition + dir * (range * glm::cos(halfAngle)), range * glm::sin(halfAngle) };
+		}
+		// Narrow cones are bounded by the sphere through the apex and the cap's base circle:
+		const float radius = range / (2.0f * glm::cos(halfAngle));
+		return glm::vec4{ aLightsource.mPosition + dir * radius, radius };
+	}
+
+	/** Culls the point and spot light sources against the view frustum, and sorts the visible ones of each type by their importance,
+	 *	i.e., by how large their bounding spheres appear on screen. Ambient and directional light sources are always kept.
+	 *	The result is still sorted by type, s.t. get_lightsource_type_begin_index/get_lightsource_type_end_index work as before.
+	 *	The bounding spheres are stored as structure of arrays, s.t. the compiler can vectorize the tests against the frustum planes.
+	 *	@param	aLightsources			The active light sources, sorted by their types
+	 *	@param	aViewProjMatrix			Projection matrix * view matrix of the camera
+	 *	@param	aCamPos					World space position of the camera
+	 *	@param	aCutoffIntensity		Intensity below which a light source's contribution is neglected
+	 *	@return	The visible light sources, sorted by their types and then by their importance (most important first)
+	 */
+	static std::vector<avk::lightsource> cull_and_sort_lightsources(const std::vector<avk::lightsource>& aLightsources, const glm::mat4& aViewProjMatrix, const glm::vec3& aCamPos, float aCutoffIntensity)
+	{
+		const size_t n = aLightsources.size();
+		std::vector<float> xs(n), ys(n), zs(n), rs(n);
+		for (size_t i = 0; i < n; ++i) {
+			const auto sphere = calc_lightsource_bounding_sphere(aLightsources[i], aCutoffIntensity);
+			xs[i] = sphere.x; ys[i] = sphere.y; zs[i] = sphere.z; rs[i] = sphere.w;
+		}
+
+		// Extract the frustum planes (pointing inwards) from the view projection matrix, for a depth range of [0, 1]:
+		const glm::mat4 m = glm::transpose(aViewProjMatrix);
+		const std::array<glm::vec4, 6> planes = { m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2] };
+
+		std::vector<uint8_t> visible(n);
+		for (size_t i = 0; i < n; ++i) {
+			visible[i] = rs[i] > 0.0f ? 1 : 0;
+		}
+		for (auto plane : planes) {
+			plane /= glm::length(glm::vec3{ plane });
+			const float* x = xs.data(); const float* y = ys.data(); const float* z = zs.data(); const float* r = rs.data();
+			uint8_t* v = visible.data();
+			for (size_t i = 0; i < n; ++i) { // <-- branch-free => vectorizable
+				v[i] &= static_cast<uint8_t>(plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w >= -r[i]);
+			}
+		}
+
+		std::vector<avk::lightsource> result;
+		result.reserve(n);
+		std::vector<std::tuple<float, size_t>> importances;
+		for (size_t begin = 0; begin < n; ) {
+			// Every type occupies a contiguous range, which is sorted on its own:
+			size_t end = begin;
+			importances.clear();
+			for (; end < n && aLightsources[end].mType == aLightsources[begin].mType; ++end) {
+				if (visible[end]) {
+					const float distance = glm::distance(aCamPos, glm::vec3{ xs[end], ys[end], zs[end] });
+					importances.emplace_back(rs[end] / glm::max(distance, 1e-3f), end);
+				}
+			}
+			std::stable_sort(std::begin(importances), std::end(importances), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+			for (const auto& [importance, index] : importances) {
+				result.push_back(aLightsources[index]);
+			}
+			begin = end;
+		}
+		return result;
+	}
+
+	/** One entry of the alias table, from which the stochastic lighting mode samples the point and spot light sources.
+	 *	Its layout corresponds to LightAliasTableEntry in lighting_pass.frag (std430).
+	 */
+	struct light_alias_table_entry
+	{
+		// Probability of choosing this entry's light source when this entry is drawn (otherwise, the one of mAlias is chosen)
+		float mProbability;
+		// Index of the entry whose light source is chosen otherwise
+		uint32_t mAlias;
+		// Probability of sampling this entry's light source from the whole table, i.e., its importance / sum of all importances
+		float mPdf;
+		// Index of the light source in the light sources storage buffer
+		uint32_t mLightIndex;
+	};
+
+	/** Header of the alias table storage buffer, followed by a runtime-sized array of light_alias_table_entry.
+	 *	Its layout corresponds to the beginning of the LightAliasTable buffer block in lighting_pass.frag (std430).
+	 */
+	struct light_alias_table_header
+	{
+		// Number of entries which follow the header
+		uint32_t mNumEntries;
+		uint32_t mPadding[3];
+	};
+
+	/** Returns the size in bytes of an alias table storage buffer which can hold the given number of entries. */
+	static size_t get_light_alias_table_size(size_t aCapacity)
+	{
+		return sizeof(light_alias_table_header) + std::max(aCapacity, size_t{ 1 }) * sizeof(light_alias_table_entry);
+	}
+
+	/** Builds an alias table over the point and spot light sources (Vose's method), s.t. each one can be sampled in O(1)
+	 *	with a probability proportional to its importance, i.e., its power: its maximum color component times the area
+	 *	which it illuminates above the cutoff intensity (limited by aMaxRange), and for spot lights, times the fraction
+	 *	of the sphere covered by the cone. The distance to the shaded point is accounted for in the lighting pass.
+	 *	@param	aLightsources			The light sources in the order in which they have been written into the lights buffer, sorted by their types
+	 *	@param	aCutoffIntensity		Intensity below which a light source's contribution is neglected
+	 *	@param	aMaxRange				Range which light sources that are not attenuated with distance are limited to
+	 *	@return	One entry per point and spot light source with a non-zero importance
+	 */
+	static std::vector<light_alias_table_entry> build_light_alias_table(const std::vector<avk::lightsource>& aLightsources, float aCutoffIntensity, float aMaxRange)
+	{
+		std::vector<light_alias_table_entry> entries;
+		std::vector<double> importances;
+		double sum = 0.0;
+		for (size_t i = 0; i < aLightsources.size(); ++i) {
+			const auto& light = aLightsources[i];
+			if (avk::lightsource_type::point != light.mType && avk::lightsource_type::spot != light.mType) {
+				continue;
+			}
+			const float range = glm::min(calc_lightsource_range(light, aCutoffIntensity), aMaxRange);
+			const float coverage = avk::lightsource_type::spot == light.mType ? (1.0f - glm::cos(glm::min(light.mAngleOuterCone * 0.5f, glm::pi<float>()))) * 0.5f : 1.0f;
+			const double importance = static_cast<double>(glm::max(light.mColor.r, glm::max(light.mColor.g, light.mColor.b)) * coverage) * range * range;
+			if (importance <= 0.0) {
+				continue;
+			}
+			entries.push_back({ 1.0f, 0u, 0.0f, static_cast<uint32_t>(i) });
+			importances.push_back(importance);
+			sum += importance;
+		}
+
+		// Scale the importances s.t. they average to 1, and split them into those below and above the average:
+		const size_t n = entries.size();
+		std::vector<double> scaled(n);
+		std::vector<uint32_t> small, large;
+		for (size_t i = 0; i < n; ++i) {
+			entries[i].mPdf = static_cast<float>(importances[i] / sum);
+			scaled[i] = importances[i] * static_cast<double>(n) / sum;
+			(scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+		}
+		// Fill up every entry below the average with (a part of) one above it:
+		while (!small.empty() && !large.empty()) {
+			const auto s = small.back(); small.pop_back();
+			const auto l = large.back();
+			entries[s].mProbability = static_cast<float>(scaled[s]);
+			entries[s].mAlias = l;
+			scaled[l] -= 1.0 - scaled[s];
+			if (scaled[l] < 1.0) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		// The remaining ones (only off the average due to rounding) always choose themselves:
+		for (auto i : small) { entries[i].mProbability = 1.0f; entries[i].mAlias = i; }
+		for (auto i : large) { entries[i].mProbability = 1.0f; entries[i].mAlias = i; }
+		return entries;
+	}
+
 	// create and initialize a lightsource editor
 	static lights_editor create_lightsource_editor(avk::queue& aQueueToSubmitTo, bool aGuiEnabled)
 	{
@@ -703,6 +998,7 @@ namespace helpers
 	}
 
 	static std::unordered_map<std::string, std::tuple<vk::UniqueQueryPool, std::array<uint32_t, 2>, float>> sIntervals;
+	static std::unordered_map<std::string, float> sOverlaps;
 
 	static vk::QueryPool& add_timing_interval_and_get_query_pool(const std::string& aName)
 	{
@@ -744,9 +1040,45 @@ namespace helpers
 		return avgRendertime;
 	}
 
+	// request the last two timing intervals from GPU (if they are available already) and return the averaged time during which they have overlapped (in ms)
+	static float get_timing_intervals_overlap_in_ms(const std::string& aFirstName, const std::string& aSecondName)
+	{
+		auto first = sIntervals.find(aFirstName);
+		auto second = sIntervals.find(aSecondName);
+		if (first == sIntervals.end() || second == sIntervals.end()) {
+			return 0.0f;
+		}
+		auto& avgOverlap = sOverlaps[aFirstName + " | " + aSecondName];
+		std::array<uint32_t, 2> a, b;
+		// Do not wait for the results, because the second interval might belong to a frame which is still in flight:
+		if (vk::Result::eSuccess != avk::context().device().getQueryPoolResults(*std::get<0>(first->second), 0u, 2u, sizeof(a), a.data(), sizeof(uint32_t), {})
+		 || vk::Result::eSuccess != avk::context().device().getQueryPoolResults(*std::get<0>(second->second), 0u, 2u, sizeof(b), b.data(), sizeof(uint32_t), {})) {
+			return avgOverlap;
+		}
+		// Everything relative to the start of the first interval, s.t. a wrap-around of the 32-bit timestamps does not matter:
+		const int64_t firstEnd = static_cast<int32_t>(a[1] - a[0]);
+		const int64_t secondBegin = static_cast<int32_t>(b[0] - a[0]);
+		const int64_t secondEnd = static_cast<int32_t>(b[1] - a[0]);
+		const auto overlap = std::max<int64_t>(0, std::min(firstEnd, secondEnd) - std::max<int64_t>(0, secondBegin));
+		float delta = overlap * avk::context().physical_device().getProperties().limits.timestampPeriod / 1000000.0f;
+		avgOverlap = avgOverlap * 0.9f + delta * 0.1f;
+		return avgOverlap;
+	}
+
+	/**	Returns the in-flight index of the oldest frame which is (potentially) still in flight.
+	 *	Its timing intervals have been recorded the longest time ago, hence reading them stalls the least.
+	 *	Use this index for reading timings which have been recorded with the current in-flight index.
+	 */
+	static avk::window::frame_id_t get_oldest_in_flight_index()
+	{
+		auto* mainWnd = avk::context().main_window();
+		return (mainWnd->in_flight_index_for_frame() + 1) % mainWnd->number_of_frames_in_flight();
+	}
+
 	static void clean_up_timing_resources()
 	{
 		sIntervals.clear();
+		sOverlaps.clear();
 	}
 }
 
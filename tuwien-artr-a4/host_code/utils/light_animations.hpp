@@ -0,0 +1,87 @@
+#pragma once
+
+#include <auto_vk_toolkit.hpp>
+
+// This class animates the positions of light sources, which are referred to by stable handles (their indices in the vector
+// of light sources). Every animation moves a light source along an ellipse (or a line) around a center:
+//
+//   position = center + sinAxis * sin(speed * t + phase) + cosAxis * cos(speed * t + phase)
+//
+// The parameters are stored as structure of arrays, and all animations are evaluated in one batch, which the compiler
+// can vectorize. Only afterwards, the results are scattered into the light sources.
+class light_animations
+{
+public:
+	/** A handle to a light source, i.e., its index in the vector of light sources which is passed to evaluate. */
+	using handle = uint32_t;
+
+	/**	Adds an animation of the light source with the given handle.
+	 *	@param	aLight		The light source to be animated
+	 *	@param	aCenter		Position around which the light source moves
+	 *	@param	aSinAxis	Offset from the center which is scaled by sin(speed * t + phase)
+	 *	@param	aCosAxis	Offset from the center which is scaled by cos(speed * t + phase)
+	 *	@param	aSpeed		Angular speed in radians per second
+	 *	@param	aPhase		Angle at t = 0
+	 */
+	void add(handle aLight, const glm::vec3& aCenter, const glm::vec3& aSinAxis, const glm::vec3& aCosAxis, float aSpeed, float aPhase = 0.0f)
+	{
+		mHandles.push_back(aLight);
+		mCenterX.push_back(aCenter.x);   mCenterY.push_back(aCenter.y);   mCenterZ.push_back(aCenter.z);
+		mSinAxisX.push_back(aSinAxis.x); mSinAxisY.push_back(aSinAxis.y); mSinAxisZ.push_back(aSinAxis.z);
+		mCosAxisX.push_back(aCosAxis.x); mCosAxisY.push_back(aCosAxis.y); mCosAxisZ.push_back(aCosAxis.z);
+		mSpeed.push_back(aSpeed);
+		mPhase.push_back(aPhase);
+		mPositionX.push_back(aCenter.x); mPositionY.push_back(aCenter.y); mPositionZ.push_back(aCenter.z);
+	}
+
+	/**	Adds an animation which moves the light source with the given handle along a horizontal circle.
+	 *	@param	aLight		The light source to be animated
+	 *	@param	aCenter		Center of the circle
+	 *	@param	aRadius		Radius of the circle
+	 *	@param	aSpeed		Angular speed in radians per second
+	 *	@param	aPhase		Angle at t = 0
+	 */
+	void add_orbit(handle aLight, const glm::vec3& aCenter, float aRadius, float aSpeed, float aPhase = 0.0f)
+	{
+		add(aLight, aCenter, glm::vec3{ aRadius, 0.0f, 0.0f }, glm::vec3{ 0.0f, 0.0f, aRadius }, aSpeed, aPhase);
+	}
+
+	/**	Evaluates all animations at the given time, and writes the resulting positions into the light sources.
+	 *	@param	aLightsources	The light sources which the handles refer to
+	 *	@param	aElapsedTime	Time in seconds
+	 *	@param	aOnModified		Invoked with the handle of every light source which has been moved
+	 */
+	template <typename F>
+	void evaluate(std::vector<avk::lightsource>& aLightsources, float aElapsedTime, F&& aOnModified)
+	{
+		const size_t n = mHandles.size();
+		// Batch evaluation of all animations (no dependencies between iterations => vectorizable):
+		for (size_t i = 0; i < n; ++i) {
+			const float angle = mSpeed[i] * aElapsedTime + mPhase[i];
+			const float s = std::sin(angle);
+			const float c = std::cos(angle);
+			mPositionX[i] = mCenterX[i] + mSinAxisX[i] * s + mCosAxisX[i] * c;
+			mPositionY[i] = mCenterY[i] + mSinAxisY[i] * s + mCosAxisY[i] * c;
+			mPositionZ[i] = mCenterZ[i] + mSinAxisZ[i] * s + mCosAxisZ[i] * c;
+		}
+		// Scatter the results into the light sources:
+		for (size_t i = 0; i < n; ++i) {
+			if (mHandles[i] < aLightsources.size()) {
+				aLightsources[mHandles[i]].mPosition = glm::vec3{ mPositionX[i], mPositionY[i], mPositionZ[i] };
+				aOnModified(mHandles[i]);
+			}
+		}
+	}
+
+	/** Returns the number of animations. */
+	size_t size() const { return mHandles.size(); }
+
+private:
+	std::vector<handle> mHandles;
+	std::vector<float> mCenterX, mCenterY, mCenterZ;
+	std::vector<float> mSinAxisX, mSinAxisY, mSinAxisZ;
+	std::vector<float> mCosAxisX, mCosAxisY, mCosAxisZ;
+	std::vector<float> mSpeed, mPhase;
+	// Results of the last evaluation:
+	std::vector<float> mPositionX, mPositionY, mPositionZ;
+};
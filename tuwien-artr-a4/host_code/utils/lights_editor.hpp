@@ -10,6 +10,7 @@
 #include "math_utils.hpp"
 #include "quake_camera.hpp"
 #include "simple_geometry.hpp"
+#include "submission_batcher.hpp"
 #include "vk_convenience_functions.hpp"
 
 class lights_editor : public avk::invokee
@@ -43,6 +44,12 @@ public:
 			fragment_shader("shaders/utils/translucent_gizmo.frag.spv"),
 
 			from_buffer_binding(0)->stream_per_vertex<glm::vec3>()->to_location(0), // aVertexPosition
+			// The model matrix occupies one location per column:
+			from_buffer_binding(1)->stream_per_instance(offsetof(GizmoInstance, mModelMatrix) + 0 * sizeof(glm::vec4), vk::Format::eR32G32B32A32Sfloat, sizeof(GizmoInstance))->to_location(1), // aModelMatrix
+			from_buffer_binding(1)->stream_per_instance(offsetof(GizmoInstance, mModelMatrix) + 1 * sizeof(glm::vec4), vk::Format::eR32G32B32A32Sfloat, sizeof(GizmoInstance))->to_location(2),
+			from_buffer_binding(1)->stream_per_instance(offsetof(GizmoInstance, mModelMatrix) + 2 * sizeof(glm::vec4), vk::Format::eR32G32B32A32Sfloat, sizeof(GizmoInstance))->to_location(3),
+			from_buffer_binding(1)->stream_per_instance(offsetof(GizmoInstance, mModelMatrix) + 3 * sizeof(glm::vec4), vk::Format::eR32G32B32A32Sfloat, sizeof(GizmoInstance))->to_location(4),
+			from_buffer_binding(1)->stream_per_instance(offsetof(GizmoInstance, mColor),                               vk::Format::eR32G32B32A32Sfloat, sizeof(GizmoInstance))->to_location(5), // aColor
 
 			cfg::front_face::define_front_faces_to_be_counter_clockwise(),
 			cfg::viewport_depth_scissors_config::from_framebuffer(avk::context().main_window()->backbuffer_reference_at_index(0)),
@@ -81,6 +88,12 @@ public:
 		mSphere.create_sphere();
 		mCone.create_cone();
 
+		// the per-instance data is kept separately for each frame in flight, since it may still be in use by a previous frame when it changes
+		const auto numFif = avk::context().main_window()->number_of_frames_in_flight();
+		mGizmoInstanceBuffers.resize(numFif);
+		mGizmoInstanceCapacities.assign(numFif, 0);
+		mGizmoInstanceRevisions.assign(numFif, std::numeric_limits<uint64_t>::max());
+
 		mGizmosInited = true;
 	}
 
@@ -119,19 +132,20 @@ public:
 			if (mIdxPnt.size() > 1) {
 				// *all* pointlights
 				if (CollapsingHeader("ALL point lights")) {
-					if (Button("Enable all"))  { for (auto idx : mIdxPnt) mLightEnabled[idx] = true;  }; SameLine();
-					if (Button("Disable all")) { for (auto idx : mIdxPnt) mLightEnabled[idx] = false; }
+					if (Button("Enable all"))  { for (auto idx : mIdxPnt) mLightEnabled[idx] = true;  mark_active_set_modified(); }; SameLine();
+					if (Button("Disable all")) { for (auto idx : mIdxPnt) mLightEnabled[idx] = false; mark_active_set_modified(); }
 					if (Button("Reset to initial state")) {
 						for (auto idx : mIdxPnt) {
 							*mLightsPtr[idx] = mLightsOriginal[idx];
+							mark_modified(idx);
 						}
 					}
 
 					// TODO: do we need a uniform position offset for the point lights?
 					auto p0 = mLightsPtr[mIdxPnt[0]];
 					glm::vec3 atten = glm::vec3(p0->mAttenuationConstant, p0->mAttenuationLinear, p0->mAttenuationQuadratic);
-					if (ColorEdit3 ("color", &p0->mColor.x, ImGuiColorEditFlags_NoInputs)) { for (auto idx : mIdxPnt) mLightsPtr[idx]->mColor = p0->mColor; }
-					if (DragFloat3("atten", &atten.x, dragSpeedAtt)                      ) { for (auto idx : mIdxPnt) mLightsPtr[idx]->set_attenuation(glm::max(0.0f, atten.x), glm::max(0.0f, atten.y), glm::max(0.0f, atten.z)); }
+					if (ColorEdit3 ("color", &p0->mColor.x, ImGuiColorEditFlags_NoInputs)) { for (auto idx : mIdxPnt) { mLightsPtr[idx]->mColor = p0->mColor; mark_modified(idx); } }
+					if (DragFloat3("atten", &atten.x, dragSpeedAtt)                      ) { for (auto idx : mIdxPnt) { mLightsPtr[idx]->set_attenuation(glm::max(0.0f, atten.x), glm::max(0.0f, atten.y), glm::max(0.0f, atten.z)); mark_modified(idx); } }
 					HelpMarker("Attenuation:\nconstant, linear, quadratic");
 				}
 			}
@@ -151,20 +165,23 @@ public:
 
 							PushID(imgui_id++);
 							if (multiple) { Text("#%d:", cnt); SameLine(); }
-							if (Checkbox("enabled", &ena)) mLightEnabled[idx] = ena;
+							// Remember if anything has been modified, s.t. only the modified light sources need to be uploaded to the GPU:
+							bool modified = false;
+							if (Checkbox("enabled", &ena)) { mLightEnabled[idx] = ena; mark_active_set_modified(); }
 							SameLine();
-							ColorEdit3 ("color", &light->mColor.x, ImGuiColorEditFlags_NoInputs);
+							modified |= ColorEdit3 ("color", &light->mColor.x, ImGuiColorEditFlags_NoInputs);
 							SameLine();
 							if (Button("reset")) {
 								*mLightsPtr[idx] = mLightsOriginal[idx];
+								modified = true;
 							}
 
 							PushItemWidth(160);
 							if (pass == 2 || pass == 3) { // spot, point
-								DragFloat3("pos",   &light->mPosition.x, dragSpeedPos);
+								modified |= DragFloat3("pos",   &light->mPosition.x, dragSpeedPos);
 							}
 							if (pass == 1 || pass == 2) { // dir, spot
-								DragFloat3("direction", &light->mDirection.x, dragSpeedDir);
+								modified |= DragFloat3("direction", &light->mDirection.x, dragSpeedDir);
 							}
 							if (pass == 2) { // spot
 								float angO = glm::degrees(light->mAngleOuterCone);
@@ -172,16 +189,20 @@ public:
 								bool draggedO = false, draggedI = false;
 								if (DragFloat("outer angle", &angO, dragSpeedAng, 0.0f, 359.9f, "%.1f")) { draggedO = true; light->mAngleOuterCone = glm::radians(angO); }
 								if (DragFloat("inner angle", &angI, dragSpeedAng, 0.0f, 359.9f, "%.1f")) { draggedI = true; light->mAngleInnerCone = glm::radians(angI); }
-								if (DragFloat("falloff", &light->mFalloff, dragSpeedFal) && light->mFalloff < 0.0f) light->mFalloff = 0.0f;
+								if (DragFloat("falloff", &light->mFalloff, dragSpeedFal)) { modified = true; if (light->mFalloff < 0.0f) light->mFalloff = 0.0f; }
+								modified |= draggedO || draggedI;
 								if (draggedO && light->mAngleOuterCone < light->mAngleInnerCone) light->mAngleInnerCone = light->mAngleOuterCone;
 								if (draggedI && light->mAngleOuterCone < light->mAngleInnerCone) light->mAngleOuterCone = light->mAngleInnerCone;
 							}
 							if (pass == 2 || pass == 3) { // spot, point
 								glm::vec3 atten = glm::vec3(light->mAttenuationConstant, light->mAttenuationLinear, light->mAttenuationQuadratic);
-								if (DragFloat3("atten", &atten.x, dragSpeedAtt)) light->set_attenuation(glm::max(0.0f, atten.x), glm::max(0.0f, atten.y), glm::max(0.0f, atten.z));
+								if (DragFloat3("atten", &atten.x, dragSpeedAtt)) { light->set_attenuation(glm::max(0.0f, atten.x), glm::max(0.0f, atten.y), glm::max(0.0f, atten.z)); modified = true; }
 								HelpMarker("Attenuation:\nconstant, linear, quadratic");
 							}
 							PopItemWidth();
+							if (modified) {
+								mark_modified(idx);
+							}
 
 							PopID();
 							cnt++;
@@ -196,12 +217,14 @@ public:
 					SliderFloat("Opacity",  &mGizmoParams.opacity, 0.01f, 1.0f);
 					Text("Scale / attenuation contribution:");
 					PushItemWidth(84);
-					SliderFloat("##PL Scale",      &mGizmoParams.scalePL,        0.01f, 100.0f); SameLine();
-					DragFloat  ("Point##PL Param", &mGizmoParams.paramPL, 0.01f, 0.01f, 10.0f);
-					SliderFloat("##SL Scale",      &mGizmoParams.scaleSL,        0.01f,  4.0f);  SameLine();
-					DragFloat  ("Spot##SL Param",  &mGizmoParams.paramSL, 0.01f, 0.01f, 10.0f);
+					bool scaleChanged = false;
+					scaleChanged |= SliderFloat("##PL Scale",      &mGizmoParams.scalePL,        0.01f, 100.0f); SameLine();
+					scaleChanged |= DragFloat  ("Point##PL Param", &mGizmoParams.paramPL, 0.01f, 0.01f, 10.0f);
+					scaleChanged |= SliderFloat("##SL Scale",      &mGizmoParams.scaleSL,        0.01f,  4.0f);  SameLine();
+					scaleChanged |= DragFloat  ("Spot##SL Param",  &mGizmoParams.paramSL, 0.01f, 0.01f, 10.0f);
 					PopItemWidth();
-					if (Button("Reset to defaults")) mGizmoParams = mGizmoParamsDefault;
+					if (Button("Reset to defaults")) { mGizmoParams = mGizmoParamsDefault; scaleChanged = true; }
+					if (scaleChanged) ++mGizmoScaleRevision;
 				}
 			}
 
@@ -232,6 +255,8 @@ public:
 		avk::lightsource copy = *ptrLightsource;
 		mLightsOriginal.push_back(copy);
 		mLightEnabled.push_back(true);
+		mModifiedRevisions.push_back(0);
+		mark_active_set_modified();
 
 		switch(ptrLightsource->mType) {
 		case avk::lightsource_type::ambient:		mIdxAmb.push_back(index);	break;
@@ -251,6 +276,45 @@ public:
 		for (auto &p : vecLightsource) add(&p);
 	}
 
+	/**	Marks the light source at the given index as modified, s.t. it is uploaded to the GPU again.
+	 *	The GUI does this for all edits; code which modifies light sources otherwise (e.g., animations) must do it, too.
+	 *	@param	aIndex		The index of the light source in the order in which it has been added to this editor. Callers which
+	 *						refer to light sources by their index in another vector (e.g., helpers::animate_lights, which uses the
+	 *						indices into helpers::get_lights()) rely on that vector having been added in the same order.
+	 */
+	void mark_modified(size_t aIndex)
+	{
+		assert(aIndex < mModifiedRevisions.size());
+		mModifiedRevisions[aIndex] = ++mRevision;
+	}
+
+	/** Returns the current revision of the light sources, which is incremented with every modification. */
+	uint64_t revision() const { return mRevision; }
+
+	/**	Returns the revision at which the set of active light sources (and therefore, the index of each of them) has changed last.
+	 *	@param	aLimitNumberOfPointLights	The same limit as passed to get_active_lights
+	 */
+	uint64_t active_set_revision(int aLimitNumberOfPointLights = -1)
+	{
+		update_active_indices(aLimitNumberOfPointLights);
+		return mActiveSetRevision;
+	}
+
+	/**	Invokes the given callback for each active light source which has been modified after the given revision.
+	 *	@param	aRevision					Light sources which have been modified after this revision are passed to aCallback
+	 *	@param	aLimitNumberOfPointLights	The same limit as passed to get_active_lights
+	 *	@param	aCallback					Receives the index of the light source among the active ones (i.e., in the result of get_active_lights), and the light source
+	 */
+	void for_each_active_light_modified_after(uint64_t aRevision, int aLimitNumberOfPointLights, const std::function<void(size_t, const avk::lightsource&)>& aCallback)
+	{
+		update_active_indices(aLimitNumberOfPointLights);
+		for (size_t i = 0; i < mLightsPtr.size(); ++i) {
+			if (mModifiedRevisions[i] > aRevision && mActiveIndices[i] >= 0) {
+				aCallback(static_cast<size_t>(mActiveIndices[i]), *mLightsPtr[i]);
+			}
+		}
+	}
+
 	std::vector<avk::lightsource> get_active_lights(int aLimitNumberOfPointLights = -1)
 	{
 		std::vector<avk::lightsource> result;
@@ -270,6 +334,11 @@ public:
 	bool is_gui_enabled() { return mGuiEnabled; }
 	void set_gui_enabled(bool aEnabled) { mGuiEnabled = aEnabled; }
 
+	/**	If set, the command buffers are handed over to the given submission batcher instead of being submitted directly.
+	 *	@param	aSubmissionBatcher	Submits all command buffers of a frame at once, or nullptr to submit directly
+	 */
+	void set_submission_batcher(submission_batcher* aSubmissionBatcher) { mSubmissionBatcher = aSubmissionBatcher; }
+
 	// TODO: make this render_gizmos() once problems with ImGui are solved
 	void render() override {
 		// get the camera
@@ -287,7 +356,15 @@ public:
 		cmdBfr->end_recording();
 
 		// SUBMIT, and establish necessary sync:
-		auto mainWnd = avk::context().main_window(); 
+		auto mainWnd = avk::context().main_window();
+		if (nullptr != mSubmissionBatcher) {
+			// The batcher submits it together with the other command buffers of this frame, and takes care of its lifetime:
+			if (!mainWnd->has_consumed_current_image_available_semaphore()) {
+				mSubmissionBatcher->add_wait(mainWnd->consume_current_image_available_semaphore()->handle(), vk::PipelineStageFlagBits2KHR::eEarlyFragmentTests);
+			}
+			mSubmissionBatcher->add(std::move(cmdBfr));
+			return;
+		}
 		auto submission = mQueue->submit(cmdBfr.as_reference());
 
 		// If this is the first render call, then consume the image available semaphore:
@@ -302,13 +379,17 @@ public:
 	}
 
 private:
-	void draw_gizmos(avk::command_buffer & cmd, const glm::mat4 & projectionViewMatrix)
+	// Rebuilds the per-instance data of the current frame in flight, if the light sources or the gizmo scale have changed since it has been built last:
+	void update_gizmo_instances()
 	{
-		// must already have started a renderpass
-
-		if (!mGizmosInited) return;
+		const auto fif = avk::context().main_window()->in_flight_index_for_frame();
+		const uint64_t revision = mRevision + mGizmoScaleRevision;
+		if (mGizmoInstanceRevisions[fif] == revision) {
+			return;
+		}
 
-		cmd->record(avk::command::bind_pipeline(mPipelineGizmos.as_reference()));
+		// All sphere instances first, followed by all cone instances:
+		mGizmoInstances.clear();
 		for (auto idx : mIdxPnt) {
 			if (mLightEnabled[idx]) {
 				avk::lightsource *p = mLightsPtr[idx];
@@ -316,13 +397,10 @@ private:
 				auto d = mGizmoParams.paramPL;
 				auto s = mGizmoParams.scalePL / (p->mAttenuationConstant + p->mAttenuationLinear * d + p->mAttenuationQuadratic * d * d);
 
-				PushConstantsGizmos pushConstants;
-				pushConstants.pvmtMatrix = projectionViewMatrix * glm::translate(p->mPosition) * glm::scale(glm::vec3(s));
-				pushConstants.uColor = glm::vec4(p->mColor, mGizmoParams.opacity);
-				cmd->handle().pushConstants(mPipelineGizmos->layout_handle(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
-				cmd->record(avk::command::draw_indexed(mSphere.mIndexBuffer.as_reference(), mSphere.mPositionsBuffer.as_reference()));
+				mGizmoInstances.push_back({ glm::translate(p->mPosition) * glm::scale(glm::vec3(s)), glm::vec4(p->mColor, 1.0f) });
 			}
 		}
+		mNumSphereInstances = static_cast<uint32_t>(mGizmoInstances.size());
 		for (auto idx : mIdxSpt) {
 			if (mLightEnabled[idx]) {
 				avk::lightsource *p = mLightsPtr[idx];
@@ -331,34 +409,135 @@ private:
 				auto s = mGizmoParams.scaleSL / (p->mAttenuationConstant + p->mAttenuationLinear * d + p->mAttenuationQuadratic * d * d);
 				auto angleScale = tan(p->mAngleOuterCone * 0.5f);
 
-				PushConstantsGizmos pushConstants;
-				pushConstants.pvmtMatrix = projectionViewMatrix
-					* glm::translate(p->mPosition)
-					* glm::toMat4(avk::rotation_between_vectors(glm::vec3(0,1,0), p->mDirection))
-					* glm::scale(glm::vec3(s * angleScale, s, s * angleScale));
-				pushConstants.uColor = glm::vec4(p->mColor, mGizmoParams.opacity);
-				cmd->handle().pushConstants(mPipelineGizmos->layout_handle(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
-				cmd->record(avk::command::draw_indexed(mCone.mIndexBuffer.as_reference(), mCone.mPositionsBuffer.as_reference()));
+				mGizmoInstances.push_back({
+					glm::translate(p->mPosition)
+						* glm::toMat4(avk::rotation_between_vectors(glm::vec3(0,1,0), p->mDirection))
+						* glm::scale(glm::vec3(s * angleScale, s, s * angleScale)),
+					glm::vec4(p->mColor, 1.0f)
+				});
+			}
+		}
+		mNumConeInstances = static_cast<uint32_t>(mGizmoInstances.size()) - mNumSphereInstances;
+
+		// (Re-)create the buffer if it is too small; it is sized for all point and spot lights, s.t. this happens only if light sources are added:
+		const size_t capacity = std::max<size_t>(1, mIdxPnt.size() + mIdxSpt.size());
+		if (mGizmoInstanceCapacities[fif] < capacity) {
+			if (mGizmoInstanceCapacities[fif] > 0) {
+				// The old one might still be in use by a previous frame:
+				avk::context().main_window()->handle_lifetime(std::move(mGizmoInstanceBuffers[fif]));
+			}
+			mGizmoInstanceBuffers[fif] = avk::context().create_buffer(avk::memory_usage::host_coherent, {}, avk::vertex_buffer_meta::create_from_element_size(sizeof(GizmoInstance), capacity));
+			mGizmoInstanceCapacities[fif] = capacity;
+		}
+		mGizmoInstances.resize(mGizmoInstanceCapacities[fif]);
+		mGizmoInstanceBuffers[fif]->fill(mGizmoInstances.data(), 0); // Host-coherent buffer => returned action_type_command will be empty.
+
+		mGizmoInstanceRevisions[fif] = revision;
+	}
+
+	void draw_gizmos(avk::command_buffer & cmd, const glm::mat4 & projectionViewMatrix)
+	{
+		// must already have started a renderpass
+
+		if (!mGizmosInited) return;
+
+		update_gizmo_instances();
+		if (0 == mNumSphereInstances + mNumConeInstances) return;
+
+		const auto fif = avk::context().main_window()->in_flight_index_for_frame();
+		const vk::Buffer instanceBuffer = mGizmoInstanceBuffers[fif]->handle();
+		const vk::DeviceSize offset = 0;
+
+		cmd->record(avk::command::bind_pipeline(mPipelineGizmos.as_reference()));
+		PushConstantsGizmos pushConstants;
+		pushConstants.pvMatrix = projectionViewMatrix;
+		pushConstants.uOpacity = mGizmoParams.opacity;
+		cmd->handle().pushConstants(mPipelineGizmos->layout_handle(), vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), &pushConstants);
+
+		// One instanced draw call for all spheres, and one for all cones:
+		auto drawInstances = [&](simple_geometry& aGeometry, uint32_t aNumInstances, uint32_t aFirstInstance) {
+			if (0 == aNumInstances) return;
+			const vk::Buffer positionsBuffer = aGeometry.mPositionsBuffer->handle();
+			cmd->handle().bindVertexBuffers(0u, { positionsBuffer, instanceBuffer }, { offset, offset });
+			cmd->handle().bindIndexBuffer(aGeometry.mIndexBuffer->handle(), 0u, vk::IndexType::eUint32);
+			cmd->handle().drawIndexed(static_cast<uint32_t>(aGeometry.mIndexBuffer->meta<avk::index_buffer_meta>().num_elements()), aNumInstances, 0u, 0, aFirstInstance);
+		};
+		drawInstances(mSphere, mNumSphereInstances, 0u);
+		drawInstances(mCone,   mNumConeInstances,   mNumSphereInstances);
+	}
+
+	void mark_active_set_modified()
+	{
+		mActiveSetRevision = ++mRevision;
+	}
+
+	// Determines the index of each light source among the active ones, in the same way as get_active_lights does:
+	void update_active_indices(int aLimitNumberOfPointLights)
+	{
+		if (mActiveIndices.size() == mLightsPtr.size() && mActiveIndicesRevision == mActiveSetRevision && mActiveIndicesLimit == aLimitNumberOfPointLights) {
+			return;
+		}
+		if (mActiveIndicesLimit != aLimitNumberOfPointLights) {
+			mark_active_set_modified();
+		}
+		mActiveIndices.assign(mLightsPtr.size(), -1);
+		int countActive = 0;
+		int countPL = 0;
+		for (size_t i = 0; i < mLightsPtr.size(); ++i) {
+			if (mLightEnabled[i]) {
+				if (aLimitNumberOfPointLights >= 0 && mLightsPtr[i]->mType == avk::lightsource_type::point) {
+					countPL++;
+					if (countPL > aLimitNumberOfPointLights) continue;
+				}
+				mActiveIndices[i] = countActive++;
 			}
 		}
+		mActiveIndicesRevision = mActiveSetRevision;
+		mActiveIndicesLimit = aLimitNumberOfPointLights;
 	}
 
 	avk::queue* mQueue;
 	avk::command_pool mCommandPool;
+	submission_batcher* mSubmissionBatcher = nullptr;
 
 	std::vector<avk::lightsource *> mLightsPtr;
 	std::vector<avk::lightsource> mLightsOriginal;
 	std::vector<int> mIdxAmb, mIdxDir, mIdxPnt, mIdxSpt, mIdxOth;
 	std::vector<bool> mLightEnabled;
 
+	// Dirty tracking: the revision at which each light source has been modified last, and at which the set of active light sources has changed last:
+	uint64_t mRevision = 0;
+	std::vector<uint64_t> mModifiedRevisions;
+	uint64_t mActiveSetRevision = 0;
+	// The index of each light source among the active ones (-1 if inactive), valid for the given revision and point lights limit:
+	std::vector<int> mActiveIndices;
+	uint64_t mActiveIndicesRevision = 0;
+	int mActiveIndicesLimit = -1;
+
 	struct PushConstantsGizmos {
-		glm::mat4 pvmtMatrix;
-		glm::vec4 uColor;
+		glm::mat4 pvMatrix;
+		float uOpacity;
+	};
+
+	// Per-instance data of a gizmo (the opacity is passed as push constant):
+	struct GizmoInstance {
+		glm::mat4 mModelMatrix;
+		glm::vec4 mColor;
 	};
 
 	avk::graphics_pipeline mPipelineGizmos;
 	simple_geometry mSphere, mCone;
 
+	// One per-instance vertex buffer per frame in flight, together with its capacity (in instances) and the revision it has been built for:
+	std::vector<avk::buffer> mGizmoInstanceBuffers;
+	std::vector<size_t> mGizmoInstanceCapacities;
+	std::vector<uint64_t> mGizmoInstanceRevisions;
+	std::vector<GizmoInstance> mGizmoInstances;
+	uint32_t mNumSphereInstances = 0;
+	uint32_t mNumConeInstances = 0;
+	// Incremented whenever the gizmo scale settings change:
+	uint64_t mGizmoScaleRevision = 0;
+
 	struct {
 		float opacity = 0.3f;
 		float scalePL = 8.0f;
@@ -12,7 +12,7 @@ void simple_geometry::create_cone(int subdivision, bool closedBase, glm::mat4 ap
 
 	float deltaTheta = glm::radians(360.f) / static_cast<float>(subdivision);
 
-	int numVert = subdivision + closedBase ? 2 : 1;
+	int numVert = subdivision + (closedBase ? 2 : 1);
 	vert.reserve(numVert);
 
 	vert.push_back(glm::vec3(0, 0, 0)); // apex
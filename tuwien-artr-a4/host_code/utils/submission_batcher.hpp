@@ -0,0 +1,135 @@
+#pragma once
+
+#include <auto_vk_toolkit.hpp>
+
+#include "invokee.hpp"
+
+// This class collects the command buffers and semaphore dependencies of all invokees during a frame,
+// and submits them to the queue with one single vkQueueSubmit2 call.
+// The command buffers can be split into multiple batches, if only some of them must wait on (or signal) a semaphore.
+class submission_batcher : public avk::invokee
+{
+public:
+	submission_batcher() : invokee("Submission Batcher", true)
+	{ }
+
+	// Execution order of 10000 => execute after all other invokees of this application have added their command buffers, but before imgui_manager
+	int execution_order() const override { return 10000; }
+
+	/**	Method to configure this invokee, intended to be invoked BEFORE this invokee's invocation of initialize()
+	 *	@param	aQueue		Stores an avk::queue* internally for future use, which has been created previously.
+	 */
+	void config(avk::queue& aQueue)
+	{
+		mQueue = &aQueue;
+	}
+
+	/**	Adds a command buffer to the current frame's submission. Command buffers are executed in the order they have been added.
+	 *	The batcher takes ownership of the command buffer and takes care of its lifetime after it has been submitted.
+	 *	@param	aCommandBuffer	A command buffer which has already been recorded
+	 */
+	void add(avk::command_buffer aCommandBuffer)
+	{
+		mBatches.back().mCommandBufferInfos.emplace_back(aCommandBuffer->handle());
+		mOwnedCommandBuffers.push_back(std::move(aCommandBuffer));
+	}
+
+	/**	Adds a command buffer to the current frame's submission, whose lifetime is handled by the caller (e.g., a reusable one).
+	 *	@param	aCommandBuffer	A command buffer which has already been recorded
+	 */
+	void add(const avk::command_buffer_t& aCommandBuffer)
+	{
+		mBatches.back().mCommandBufferInfos.emplace_back(aCommandBuffer.handle());
+	}
+
+	/**	Lets the current batch wait on the given semaphore.
+	 *	@param	aSemaphore	The semaphore to wait on. It must stay alive until the submission has completed.
+	 *	@param	aDstStages	The stages which must wait for the semaphore to be signaled
+	 *	@param	aValue		The value to wait for, if aSemaphore is a timeline semaphore
+	 */
+	void add_wait(vk::Semaphore aSemaphore, vk::PipelineStageFlags2KHR aDstStages, uint64_t aValue = 0)
+	{
+		mBatches.back().mWaitInfos.emplace_back(aSemaphore, aValue, aDstStages);
+	}
+
+	/**	Lets the current batch signal the given semaphore.
+	 *	@param	aSemaphore	The semaphore to signal. It must stay alive until the submission has completed.
+	 *	@param	aSrcStages	The stages which must have completed before the semaphore is signaled
+	 *	@param	aValue		The value to signal, if aSemaphore is a timeline semaphore
+	 */
+	void add_signal(vk::Semaphore aSemaphore, vk::PipelineStageFlags2KHR aSrcStages, uint64_t aValue = 0)
+	{
+		mBatches.back().mSignalInfos.emplace_back(aSemaphore, aValue, aSrcStages);
+	}
+
+	/**	Starts a new batch, s.t. subsequently added command buffers and semaphore waits do not affect the previous ones.
+	 *	The signal operations of the previous batch happen after its command buffers have completed.
+	 */
+	void begin_batch()
+	{
+		if (!mBatches.back().empty()) {
+			mBatches.emplace_back();
+		}
+	}
+
+	// Statistics of the last frame, intended to be displayed in the UI:
+	size_t num_submissions() const { return mNumSubmissions; }
+	size_t num_batches() const { return mNumBatches; }
+	size_t num_command_buffers() const { return mNumCommandBuffers; }
+
+	// Submit all command buffers which have been added during this frame at once:
+	void render() override
+	{
+		std::vector<vk::SubmitInfo2KHR> submitInfos;
+		mNumCommandBuffers = 0;
+		for (const auto& b : mBatches) {
+			if (b.empty()) {
+				continue;
+			}
+			submitInfos.push_back(vk::SubmitInfo2KHR{}
+				.setWaitSemaphoreInfos(b.mWaitInfos)
+				.setCommandBufferInfos(b.mCommandBufferInfos)
+				.setSignalSemaphoreInfos(b.mSignalInfos));
+			mNumCommandBuffers += b.mCommandBufferInfos.size();
+		}
+		mNumBatches = submitInfos.size();
+		mNumSubmissions = 0;
+		if (!submitInfos.empty()) {
+			// Let's just use the raw Vulkan-Hpp function, because avk::queue::submit only handles a single command buffer:
+			mQueue->handle().submit2KHR(submitInfos);
+			mNumSubmissions = 1;
+		}
+
+		// Use a convenience function of avk::window to take care of the command buffers' lifetimes:
+		// They will get deleted in the future after #concurrent-frames have passed by.
+		for (auto& cmdBfr : mOwnedCommandBuffers) {
+			avk::context().main_window()->handle_lifetime(std::move(cmdBfr));
+		}
+		mOwnedCommandBuffers.clear();
+		mBatches.clear();
+		mBatches.emplace_back();
+	}
+
+private:
+	/** Command buffers which are submitted together, and the semaphores which they wait on and signal */
+	struct batch
+	{
+		bool empty() const { return mCommandBufferInfos.empty() && mWaitInfos.empty() && mSignalInfos.empty(); }
+
+		std::vector<vk::CommandBufferSubmitInfoKHR> mCommandBufferInfos;
+		std::vector<vk::SemaphoreSubmitInfoKHR> mWaitInfos;
+		std::vector<vk::SemaphoreSubmitInfoKHR> mSignalInfos;
+	};
+
+	/** One single queue to submit all the commands to: */
+	avk::queue* mQueue;
+
+	// Everything which is to be submitted during the current frame:
+	std::vector<avk::command_buffer> mOwnedCommandBuffers;
+	std::vector<batch> mBatches = std::vector<batch>(1);
+
+	// Statistics:
+	size_t mNumSubmissions = 0;
+	size_t mNumBatches = 0;
+	size_t mNumCommandBuffers = 0;
+};
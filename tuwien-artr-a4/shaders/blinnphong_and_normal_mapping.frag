@@ -33,15 +33,17 @@ layout(push_constant) uniform PushConstantsBlock { PushConstants pushConstants;
 // Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
 layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
 
-// "mLightsources" uniform buffer containing all the light source data:
-layout(set = 1, binding = 1) uniform LightsourceData
+// "mLightsources" storage buffer containing all the light source data (its size is only limited by the host-side buffer):
+layout(set = 1, binding = 1) readonly buffer LightsourceData
 {
 	// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
 	uvec4 mRangesAmbientDirectional;
 	// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
 	uvec4 mRangesPointSpot;
+	// Number of elements in mLightData
+	uint mNumLightsources;
 	// Contains all the data of all the active light sources
-	LightsourceGpuData mLightData[MAX_NUMBER_OF_LIGHTSOURCES];
+	LightsourceGpuData mLightData[];
 } uboLights;
 // -------------------------------------------------------
 
@@ -60,6 +62,7 @@ layout (location = 0) in VertexData
 // ###### FRAG OUTPUT ####################################
 layout (location = 0) out vec4 oFragUvNrm;
 layout (location = 1) out uvec4 oFragMatId;
+layout (location = 2) out vec2 oFragVelocity;
 // -------------------------------------------------------
 
 // ###### HELPER FUNCTIONS ###############################
@@ -159,6 +162,12 @@ void main()
 	vec2 finalUV = get_final_texture_coordinates_for_diffuse_texture();
 	oFragMatId  = pack_material_and_texture_gradients(pushConstants.mMaterialIndex, vec4(dFdx(finalUV), dFdy(finalUV)));
 
+	// Screen space motion since the previous frame (in texture coordinates), without the jitter of temporal anti-aliasing.
+	// The model matrices are static => this frame's view space position is transformed with the previous view-projection matrix:
+	vec4 currentCS  = uboMatricesAndUserInput.mUnjitteredProjMatrix * vec4(fs_in.positionVS, 1.0);
+	vec4 previousCS = uboMatricesAndUserInput.mViewToPrevClipMatrix * vec4(fs_in.positionVS, 1.0);
+	oFragVelocity = (currentCS.xy / currentCS.w - previousCS.xy / previousCS.w) * 0.5;
+
 	// TODO Task 6, TODO Bonus Task 2:
 	//  - Read roughness and metallic values from textures and pass them on to the lighting subpass
 	//  - You can use the provided functions sample_roughness() and sample_metallic() to read from the textures
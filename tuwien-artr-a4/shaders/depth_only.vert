@@ -0,0 +1,39 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#include "shader_structures.glsl"
+// -------------------------------------------------------
+
+// ###### VERTEX SHADER/PIPELINE INPUT DATA ##############
+// Only the positions are streamed for the depth pre-pass:
+layout (location = 0) in vec3 aPosition;
+
+// Unique push constants per draw call (You can think of
+// these like single uniforms in OpenGL):
+layout(push_constant) uniform PushConstantsBlock { PushConstants pushConstants; };
+
+// Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
+layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
+// -------------------------------------------------------
+
+// ###### DATA PASSED ON ALONG THE PIPELINE ##############
+// Must produce exactly the same depth values as
+// transform_and_pass_on.vert, because the G-Buffer pass
+// tests for depth EQUAL after the depth pre-pass:
+invariant gl_Position;
+// -------------------------------------------------------
+
+// ###### VERTEX SHADER MAIN #############################
+void main()
+{
+	mat4 mMatrix = pushConstants.mModelMatrix;
+	mat4 vMatrix = uboMatricesAndUserInput.mViewMatrix;
+	mat4 pMatrix = uboMatricesAndUserInput.mProjMatrix;
+	mat4 vmMatrix = vMatrix * mMatrix;
+
+	vec4 positionOS  = vec4(aPosition, 1.0);
+	vec4 positionVS  = vmMatrix * positionOS;
+	vec4 positionCS  = pMatrix * positionVS;
+
+	gl_Position = positionCS;
+}
+// -------------------------------------------------------
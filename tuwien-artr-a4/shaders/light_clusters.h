@@ -0,0 +1,24 @@
+#ifndef LIGHT_CLUSTERS_H
+
+// For clustered shading, the view frustum is divided into a 3D grid of clusters (also called froxels):
+// LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y screen tiles, each one divided into LIGHT_CLUSTERS_Z depth slices.
+// The depth slices are distributed exponentially between the near and the far plane.
+
+#define LIGHT_CLUSTERS_X	16
+#define LIGHT_CLUSTERS_Y	9
+#define LIGHT_CLUSTERS_Z	24
+
+// The light indices of all clusters are stored in one compact list. Its capacity suffices for this many lights per cluster on average:
+#define AVERAGE_LIGHTS_PER_CLUSTER	64
+
+// Number of clusters which are processed by one work group of the light culling compute shader:
+#define LIGHT_CULLING_WORKGROUP_SIZE	64
+
+
+// --- derived values ---
+
+#define NUMBER_OF_LIGHT_CLUSTERS (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+#define LIGHT_CLUSTER_INDEX_CAPACITY (NUMBER_OF_LIGHT_CLUSTERS * AVERAGE_LIGHTS_PER_CLUSTER)
+
+#define LIGHT_CLUSTERS_H 1
+#endif
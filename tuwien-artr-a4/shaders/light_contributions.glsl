@@ -0,0 +1,95 @@
+//? #version 460
+// above line is just for the VS GLSL language integration plugin
+
+#ifndef LIGHT_CONTRIBUTIONS_GLSL
+#define LIGHT_CONTRIBUTIONS_GLSL 1
+
+// Functions which calculate the contributions of single light sources, shared by the lighting pass and the light volumes.
+// The including shader must have declared the light sources storage buffer as "uboLights" before including this file.
+
+// Calculates the light attenuation dividend for the given attenuation vector.
+// @param atten attenuation data
+// @param dist  distance
+// @param dist2 squared distance
+float calc_attenuation(vec4 atten, float dist, float dist2)
+{
+	return atten[0] + atten[1] * dist + atten[2] * dist2;
+}
+
+// Calculates the diffuse and specular illumination contribution for the given
+// parameters according to the Blinn-Phong lighting model.
+// All parameters must be normalized.
+vec3 calc_blinn_phong_contribution(vec3 toLight, vec3 toEye, vec3 normal, vec3 diffFactor, vec3 specFactor, float specShininess)
+{
+	float nDotL = max(0.0, dot(normal, toLight)); // lambertian coefficient
+	vec3 h = normalize(toLight + toEye);
+	float nDotH = max(0.0, dot(normal, h));
+	float specPower = (nDotH == 0 && specShininess == 0) ? 1 : pow(nDotH, specShininess);
+
+	vec3 diffuse = diffFactor * nDotL; // component-wise product
+	vec3 specular = specFactor * specPower;
+
+	return diffuse + specular;
+}
+
+// Calculates the diffuse and specular illumination contribution of the point light with the given index.
+vec3 calc_point_light_contribution(uint i, mat4 viewMatrix, vec3 posVS, vec3 toEyeNrmVS, vec3 normalVS, vec3 diff, vec3 spec, float shini)
+{
+	vec3 lightPosVS = (viewMatrix * vec4(uboLights.mLightData[i].mPosition.xyz, 1.0)).xyz;
+	vec3 toLight = lightPosVS - posVS;
+	float distSq = dot(toLight, toLight);
+	float dist = sqrt(distSq);
+	vec3 toLightNrm = toLight / dist;
+
+	float atten = calc_attenuation(uboLights.mLightData[i].mAttenuation, dist, distSq);
+	vec3 intensity = uboLights.mLightData[i].mColor.rgb / atten;
+	return intensity * calc_blinn_phong_contribution(toLightNrm, toEyeNrmVS, normalVS, diff, spec, shini);
+}
+
+// Calculates the diffuse and specular illumination contribution of the spot light with the given index.
+vec3 calc_spot_light_contribution(uint i, mat4 viewMatrix, vec3 posVS, vec3 toEyeNrmVS, vec3 normalVS, vec3 diff, vec3 spec, float shini)
+{
+	vec3 lightPosVS = (viewMatrix * vec4(uboLights.mLightData[i].mPosition.xyz, 1.0)).xyz;
+	vec3 toLight = lightPosVS - posVS;
+	float distSq = dot(toLight, toLight);
+	float dist = sqrt(distSq);
+	vec3 toLightNrm = toLight / dist;
+
+	float atten = calc_attenuation(uboLights.mLightData[i].mAttenuation, dist, distSq);
+	vec3 intensity = uboLights.mLightData[i].mColor.rgb / atten;
+
+	vec3 dirVS = mat3(viewMatrix) * uboLights.mLightData[i].mDirection.xyz;
+	float cosOfHalfOuter = uboLights.mLightData[i].mAnglesFalloff[0];
+	float cosOfHalfInner = uboLights.mLightData[i].mAnglesFalloff[1];
+	float falloff = uboLights.mLightData[i].mAnglesFalloff[2];
+	float cosAlpha = dot(-toLightNrm, dirVS);
+	float da = cosAlpha - cosOfHalfOuter;
+	float fade = cosOfHalfInner - cosOfHalfOuter;
+	intensity *= da <= 0.0 ? 0.0 : pow(min(1.0, da / max(0.0001, fade)), falloff);
+
+	return intensity * calc_blinn_phong_contribution(toLightNrm, toEyeNrmVS, normalVS, diff, spec, shini);
+}
+
+// Calculates the distance from the light source with the given index, beyond which its intensity
+// (i.e., color / attenuation) drops below the given cutoff intensity (same as in cluster_lights.comp).
+// Light sources which are not attenuated with distance are limited to the given maximum range.
+float calc_light_range(uint i, float cutoffIntensity, float maxRange)
+{
+	vec3 color = uboLights.mLightData[i].mColor.rgb;
+	vec4 atten = uboLights.mLightData[i].mAttenuation;
+
+	// Solve atten[0] + atten[1] * r + atten[2] * r^2 = k for r:
+	float k = max(color.r, max(color.g, color.b)) / cutoffIntensity;
+	if (atten[0] >= k) {
+		return 0.0; // never bright enough
+	}
+	if (atten[2] > 0.0) {
+		return min(maxRange, (-atten[1] + sqrt(atten[1] * atten[1] - 4.0 * atten[2] * (atten[0] - k))) / (2.0 * atten[2]));
+	}
+	if (atten[1] > 0.0) {
+		return min(maxRange, (k - atten[0]) / atten[1]);
+	}
+	return maxRange;
+}
+
+#endif
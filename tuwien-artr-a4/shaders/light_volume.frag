@@ -0,0 +1,102 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : enable
+#include "shader_structures.glsl"
+#include "custom_packing.glsl"
+// -------------------------------------------------------
+
+// ###### MATERIAL DATA ##################################
+layout(set = 0, binding = 0) buffer Material
+{
+	MaterialGpuData materials[];
+} materialsBuffer;
+
+layout(set = 0, binding = 1) uniform sampler2D textures[];
+// -------------------------------------------------------
+
+// ###### PIPELINE INPUT DATA ############################
+// Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
+layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
+
+// "mLightsources" storage buffer containing all the light source data (its size is only limited by the host-side buffer):
+layout(set = 1, binding = 1) readonly buffer LightsourceData
+{
+	// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
+	uvec4 mRangesAmbientDirectional;
+	// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
+	uvec4 mRangesPointSpot;
+	// Number of elements in mLightData
+	uint mNumLightsources;
+	// Contains all the data of all the active light sources
+	LightsourceGpuData mLightData[];
+} uboLights;
+// -------------------------------------------------------
+
+// ###### FRAG INPUT #####################################
+layout (location = 0) in VertexData
+{
+	vec4 clipPos;
+	flat uint lightIndex;
+	flat float range;
+} fs_in;
+
+layout (input_attachment_index = 0, set = 2, binding = 0) uniform subpassInput iDepth;
+layout (input_attachment_index = 1, set = 2, binding = 1) uniform subpassInput iUvNrm;
+layout (input_attachment_index = 2, set = 2, binding = 2) uniform usubpassInput iMatId;
+// -------------------------------------------------------
+
+// ###### FRAG OUTPUT ####################################
+// Added to the result of the full-screen lighting pass (additive blending):
+layout (location = 0) out vec4 oFragColor;
+// -------------------------------------------------------
+
+#include "light_contributions.glsl"
+
+// ###### FRAGMENT SHADER MAIN #############################
+// Shades the G-Buffer fragment behind this fragment of a light volume with the volume's light source only.
+// The depth test already rejects fragments whose G-Buffer surface lies behind the volume. Of the remaining ones,
+// those whose G-Buffer position lies in front of the volume, i.e., outside of the light's range, are rejected right after the depth load.
+void main()
+{
+	float depth = subpassLoad(iDepth).r;
+	if (depth == 1) discard;
+
+	// reconstruct position from depth buffer
+	vec2 ndc = fs_in.clipPos.xy / fs_in.clipPos.w;
+	vec4 viewSpace = uboMatricesAndUserInput.mInverseProjMatrix * vec4(ndc, depth, 1);
+	vec3 positionVS = viewSpace.xyz / viewSpace.w;
+
+	uint i = fs_in.lightIndex;
+	mat4 viewMatrix = uboMatricesAndUserInput.mViewMatrix;
+	vec3 lightPosVS = (viewMatrix * vec4(uboLights.mLightData[i].mPosition.xyz, 1.0)).xyz;
+	vec3 toLight = lightPosVS - positionVS;
+	if (dot(toLight, toLight) > fs_in.range * fs_in.range) discard;
+
+	vec4 uvNormal = subpassLoad(iUvNrm).rgba;
+	uint tmp_umatIndex;
+	vec4 tmp_ddx_ddy;
+	unpack_material_and_texture_gradients(subpassLoad(iMatId), tmp_umatIndex, tmp_ddx_ddy);
+	int matIndex = int(tmp_umatIndex);
+
+	// unpack uv and normal
+	vec2 uv = uvNormal.rg;
+	vec3 normalVS = vec3(cos(uvNormal.z) * cos(uvNormal.w), sin(uvNormal.z) * cos(uvNormal.w), sin(uvNormal.w));
+
+	int diffTexIndex = materialsBuffer.materials[matIndex].mDiffuseTexIndex;
+	vec4 diffOffsetTiling = materialsBuffer.materials[matIndex].mDiffuseTexOffsetTiling;
+	int specTexIndex = materialsBuffer.materials[matIndex].mSpecularTexIndex;
+	vec4 specOffsetTiling = materialsBuffer.materials[matIndex].mSpecularTexOffsetTiling;
+	vec3  diffTexColor = textureGrad(textures[diffTexIndex], uv * diffOffsetTiling.zw + diffOffsetTiling.xy, tmp_ddx_ddy.xy, tmp_ddx_ddy.zw).rgb;
+	float specTexValue = textureGrad(textures[specTexIndex], uv * specOffsetTiling.zw + specOffsetTiling.xy, tmp_ddx_ddy.xy, tmp_ddx_ddy.zw).r;
+
+	vec3 diff       = materialsBuffer.materials[matIndex].mDiffuseReflectivity.rgb * diffTexColor;
+	vec3 spec       = materialsBuffer.materials[matIndex].mSpecularReflectivity.rgb * specTexValue;
+	float shininess = materialsBuffer.materials[matIndex].mShininess;
+
+	vec3 toEyeNrmVS = normalize(-positionVS);
+	vec3 diffAndSpec = i >= uboLights.mRangesPointSpot[2]
+		? calc_spot_light_contribution (i, viewMatrix, positionVS, toEyeNrmVS, normalVS, diff, spec, shininess)
+		: calc_point_light_contribution(i, viewMatrix, positionVS, toEyeNrmVS, normalVS, diff, spec, shininess);
+	oFragColor = vec4(diffAndSpec, 0.0);
+}
+// -------------------------------------------------------
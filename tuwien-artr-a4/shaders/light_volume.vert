@@ -0,0 +1,71 @@
+#version 460
+#extension GL_GOOGLE_include_directive : enable
+#include "shader_structures.glsl"
+// -------------------------------------------------------
+
+// ###### VERTEX SHADER/PIPELINE INPUT DATA ##############
+// Several vertex attributes (These are the buffers passed
+// to command_buffer_t::draw_indexed in the same order):
+layout (location = 0) in vec3 aPosition;
+
+// Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
+layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
+
+// "mLightsources" storage buffer containing all the light source data (its size is only limited by the host-side buffer):
+layout(set = 1, binding = 1) readonly buffer LightsourceData
+{
+	// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
+	uvec4 mRangesAmbientDirectional;
+	// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
+	uvec4 mRangesPointSpot;
+	// Number of elements in mLightData
+	uint mNumLightsources;
+	// Contains all the data of all the active light sources
+	LightsourceGpuData mLightData[];
+} uboLights;
+// -------------------------------------------------------
+
+#include "light_contributions.glsl"
+
+// ###### DATA PASSED ON ALONG THE PIPELINE ##############
+// Data from vert -> frag:
+layout (location = 0) out VertexData {
+	// Clip space position, interpolated perspective-correctly s.t. the fragment shader can calculate its screen position
+	vec4 clipPos;
+	// Index of the light source whose volume is drawn (into uboLights.mLightData)
+	flat uint lightIndex;
+	// Distance beyond which the light source's contribution is neglected
+	flat float range;
+} v_out;
+// -------------------------------------------------------
+
+// ###### VERTEX SHADER MAIN #############################
+// Every instance is the volume of one light source, and gl_InstanceIndex is its index (the host sets firstInstance accordingly).
+// Point lights are drawn as unit spheres, scaled by their range. Spot lights are drawn as unit cones (apex at the origin,
+// base at y = +1), stretched along their direction by their range, s.t. the cone contains all points within the outer angle.
+void main()
+{
+	uint i = uint(gl_InstanceIndex);
+	float range = calc_light_range(i, uboMatricesAndUserInput.mClusteringParams.z, uboMatricesAndUserInput.mClusteringParams.y);
+	vec3 lightPos = uboLights.mLightData[i].mPosition.xyz;
+
+	vec3 posWS;
+	if (i >= uboLights.mRangesPointSpot[2]) {
+		vec3 dir = normalize(uboLights.mLightData[i].mDirection.xyz);
+		vec3 tangent = normalize(cross(dir, abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+		vec3 bitangent = cross(dir, tangent);
+		// Outer cone angles close to (or beyond) 180 degrees are not supported:
+		float cosOfHalfOuter = max(uboLights.mLightData[i].mAnglesFalloff[0], 0.0175);
+		float radius = range * sqrt(1.0 - cosOfHalfOuter * cosOfHalfOuter) / cosOfHalfOuter;
+		posWS = lightPos + (aPosition.x * tangent + aPosition.z * bitangent) * radius + aPosition.y * dir * range;
+	}
+	else {
+		posWS = lightPos + aPosition * range;
+	}
+
+	v_out.clipPos = uboMatricesAndUserInput.mProjMatrix * uboMatricesAndUserInput.mViewMatrix * vec4(posWS, 1.0);
+	v_out.lightIndex = i;
+	v_out.range = range;
+	gl_Position = v_out.clipPos;
+}
+// -------------------------------------------------------
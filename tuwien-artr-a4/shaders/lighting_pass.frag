@@ -1,7 +1,9 @@
 #version 460
 #extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_samplerless_texture_functions : require
 #extension GL_GOOGLE_include_directive : enable
 #include "lightsource_limits.h"
+#include "light_clusters.h"
 #include "shader_structures.glsl"
 #include "custom_packing.glsl"
 // -------------------------------------------------------
@@ -25,16 +27,44 @@ layout(set = 0, binding = 1) uniform sampler2D textures[];
 // Uniform buffer "uboMatricesAndUserInput", containing camera matrices and user input
 layout (set = 1, binding = 0) uniform UniformBlock { matrices_and_user_input uboMatricesAndUserInput; };
 
-// "mLightsources" uniform buffer containing all the light source data:
-layout(set = 1, binding = 1) uniform LightsourceData
+// "mLightsources" storage buffer containing all the light source data (its size is only limited by the host-side buffer):
+layout(set = 1, binding = 1) readonly buffer LightsourceData
 {
 	// x,y ... ambient light sources start and end indices; z,w ... directional light sources start and end indices
 	uvec4 mRangesAmbientDirectional;
 	// x,y ... point light sources start and end indices; z,w ... spot light sources start and end indices
 	uvec4 mRangesPointSpot;
+	// Number of elements in mLightData
+	uint mNumLightsources;
 	// Contains all the data of all the active light sources
-	LightsourceGpuData mLightData[MAX_NUMBER_OF_LIGHTSOURCES];
+	LightsourceGpuData mLightData[];
 } uboLights;
+
+// The light clusters, each one containing the indices of the point and spot lights which affect it (written by cluster_lights.comp):
+layout(set = 1, binding = 2) readonly buffer LightClusters
+{
+	uint mNumLightIndices;
+	uint _padding;
+	// For each cluster: x ... offset into mLightIndices, y ... number of point and spot light sources affecting it
+	uvec2 mClusters[NUMBER_OF_LIGHT_CLUSTERS];
+	// Indices into uboLights.mLightData, compactly stored one cluster after the other
+	uint mLightIndices[LIGHT_CLUSTER_INDEX_CAPACITY];
+} ssboClusters;
+
+// The alias table, which the stochastic lighting samples the point and spot lights from (see helpers::build_light_alias_table):
+struct LightAliasTableEntry
+{
+	float mProbability; // probability of choosing this entry's light source, otherwise the one of mAlias
+	uint mAlias;
+	float mPdf;         // probability of sampling this entry's light source from the whole table
+	uint mLightIndex;   // index into uboLights.mLightData
+};
+layout(set = 1, binding = 3) readonly buffer LightAliasTable
+{
+	uint mNumEntries;
+	uint _padding[3];
+	LightAliasTableEntry mEntries[];
+} ssboAliasTable;
 // -------------------------------------------------------
 
 // ###### FRAG INPUT #####################################
@@ -46,6 +76,11 @@ layout (location = 0) in VertexData
 layout (input_attachment_index = 0, set = 2, binding = 0) uniform subpassInput iDepth;
 layout (input_attachment_index = 1, set = 2, binding = 1) uniform subpassInput iUvNrm;
 layout (input_attachment_index = 2, set = 2, binding = 2) uniform usubpassInput iMatId;
+
+// The previous frame's lit scene and depth, which the stochastic lighting is accumulated with:
+layout (set = 2, binding = 3) uniform sampler uHistorySampler;
+layout (set = 2, binding = 4) uniform texture2D uHistoryColor;
+layout (set = 2, binding = 5) uniform texture2D uHistoryDepth;
 // -------------------------------------------------------
 
 // ###### FRAG OUTPUT ####################################
@@ -53,6 +88,8 @@ layout (location = 0) out vec4 oFragColor;
 // -------------------------------------------------------
 
 // ###### HELPER FUNCTIONS ###############################
+#include "light_contributions.glsl"
+
 vec4 sample_from_diffuse_texture(int matIndex, vec2 uv)
 {
 	int texIndex = materialsBuffer.materials[matIndex].mDiffuseTexIndex;
@@ -122,29 +159,99 @@ vec4 sample_from_extra_texture_with_final_gradient(int matIndex, vec2 uv, vec2 g
 }
 
 
-// Calculates the light attenuation dividend for the given attenuation vector.
-// @param atten attenuation data
-// @param dist  distance
-// @param dist2 squared distance
-float calc_attenuation(vec4 atten, float dist, float dist2)
+// Determines the index of the light cluster which contains the given view space position:
+uint find_light_cluster(vec3 posVS)
 {
-	return atten[0] + atten[1] * dist + atten[2] * dist2;
+	float near = uboMatricesAndUserInput.mClusteringParams.x;
+	float far  = uboMatricesAndUserInput.mClusteringParams.y;
+	uvec2 tile = min(uvec2(fs_in.texCoords * vec2(LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y)), uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+	// The depth slices are distributed exponentially => invert near * (far / near)^(slice / LIGHT_CLUSTERS_Z):
+	float slice = log(max(-posVS.z, near) / near) / log(far / near) * float(LIGHT_CLUSTERS_Z);
+	uint z = min(uint(slice), uint(LIGHT_CLUSTERS_Z - 1));
+	return tile.x + tile.y * LIGHT_CLUSTERS_X + z * (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y);
 }
 
-// Calculates the diffuse and specular illumination contribution for the given
-// parameters according to the Blinn-Phong lighting model.
-// All parameters must be normalized.
-vec3 calc_blinn_phong_contribution(vec3 toLight, vec3 toEye, vec3 normal, vec3 diffFactor, vec3 specFactor, float specShininess)
+// Returns a pseudo-random number in [0, 1), and advances the given state (PCG hash):
+float next_random(inout uint state)
 {
-	float nDotL = max(0.0, dot(normal, toLight)); // lambertian coefficient
-	vec3 h = normalize(toLight + toEye);
-	float nDotH = max(0.0, dot(normal, h));
-	float specPower = (nDotH == 0 && specShininess == 0) ? 1 : pow(nDotH, specShininess);
+	state = state * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	word = (word >> 22u) ^ word;
+	return float(word >> 8u) / 16777216.0;
+}
+
+// Draws an entry from the alias table in O(1):
+uint sample_alias_table(inout uint rng)
+{
+	uint n = ssboAliasTable.mNumEntries;
+	uint entry = min(uint(next_random(rng) * float(n)), n - 1u);
+	return next_random(rng) < ssboAliasTable.mEntries[entry].mProbability ? entry : ssboAliasTable.mEntries[entry].mAlias;
+}
 
-	vec3 diffuse = diffFactor * nDotL; // component-wise product
-	vec3 specular = specFactor * specPower;
+// Estimates the diffuse and specular illumination contribution of all the point and spot lights by evaluating only a fixed number of them.
+// Every light sample is chosen from several candidates, which are drawn from the alias table proportionally to their power, by
+// resampled importance sampling: The candidates are weighted with their (cheap) unshadowed intensity at the given position.
+vec3 calc_stochastic_illumination_in_vs(mat4 viewMatrix, vec3 posVS, vec3 toEyeNrmVS, vec3 normalVS, vec3 diff, vec3 spec, float shini)
+{
+	if (ssboAliasTable.mNumEntries == 0u) {
+		return vec3(0.0);
+	}
+	uint numSamples    = uint(uboMatricesAndUserInput.mStochasticLightsParams.x);
+	uint numCandidates = uint(uboMatricesAndUserInput.mStochasticLightsParams.y);
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	uint rng = (pixel.x * 1973u + pixel.y * 9277u + uint(uboMatricesAndUserInput.mStochasticLightsParams.w) * 26699u) | 1u;
+
+	vec3 diffAndSpec = vec3(0.0);
+	for (uint s = 0u; s < numSamples; ++s) {
+		uint chosen = 0u;
+		float chosenTarget = 0.0;
+		float weightSum = 0.0;
+		for (uint c = 0u; c < numCandidates; ++c) {
+			LightAliasTableEntry candidate = ssboAliasTable.mEntries[sample_alias_table(rng)];
+			vec3 toLight = (viewMatrix * vec4(uboLights.mLightData[candidate.mLightIndex].mPosition.xyz, 1.0)).xyz - posVS;
+			float distSq = dot(toLight, toLight);
+			vec3 color = uboLights.mLightData[candidate.mLightIndex].mColor.rgb;
+			float target = max(color.r, max(color.g, color.b)) / calc_attenuation(uboLights.mLightData[candidate.mLightIndex].mAttenuation, sqrt(distSq), distSq);
+			float weight = target / candidate.mPdf;
+			weightSum += weight;
+			if (next_random(rng) * weightSum < weight) {
+				chosen = candidate.mLightIndex;
+				chosenTarget = target;
+			}
+		}
+		if (chosenTarget <= 0.0) {
+			continue;
+		}
+		vec3 contribution = chosen >= uboLights.mRangesPointSpot[0] && chosen < uboLights.mRangesPointSpot[1]
+			? calc_point_light_contribution(chosen, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini)
+			: calc_spot_light_contribution (chosen, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini);
+		diffAndSpec += contribution * (weightSum / float(numCandidates)) / chosenTarget;
+	}
+	return diffAndSpec / float(max(numSamples, 1u));
+}
 
-	return diffuse + specular;
+// Blends the given color with the previous frame's color at the position where the given view space position has been
+// visible in the previous frame. If it has been outside of the screen or occluded there, the history is discarded.
+vec3 blend_with_history(vec3 color, vec3 posVS)
+{
+	float alpha = uboMatricesAndUserInput.mStochasticLightsParams.z;
+	if (alpha >= 1.0) {
+		return color;
+	}
+	vec4 historyClip = uboMatricesAndUserInput.mViewToHistoryClipMatrix * vec4(posVS, 1.0);
+	vec2 historyUv = historyClip.xy / historyClip.w * 0.5 + 0.5;
+	if (any(lessThan(historyUv, vec2(0.0))) || any(greaterThan(historyUv, vec2(1.0)))) {
+		return color;
+	}
+	// Compare the view space depths (the projection is assumed not to change, apart from jittering):
+	ivec2 historySize = textureSize(uHistoryDepth, 0);
+	float historyDepth = texelFetch(uHistoryDepth, min(ivec2(historyUv * vec2(historySize)), historySize - 1), 0).r;
+	vec4 historyPosVS = uboMatricesAndUserInput.mInverseProjMatrix * vec4(historyUv * 2.0 - 1.0, historyDepth, 1.0);
+	if (abs(-historyPosVS.z / historyPosVS.w - historyClip.w) > 0.02 * historyClip.w) {
+		return color;
+	}
+	vec3 history = texture(sampler2D(uHistoryColor, uHistorySampler), historyUv).rgb;
+	return mix(history, color, alpha);
 }
 
 // Calculates the diffuse and specular illumination contribution for all the light sources.
@@ -153,53 +260,49 @@ vec3 calc_illumination_in_vs(vec3 posVS, vec3 normalVS, vec3 diff, vec3 spec, fl
 {
 	vec3 diffAndSpec = vec3(0.0, 0.0, 0.0);
 
-	// Calculate shading in view space since all light parameters are passed to the shader in view space
+	// Calculate shading in view space. The light parameters are stored in world space (s.t. they only have to be
+	// uploaded when they change, not whenever the camera moves), hence transform them into view space here:
+	mat4 viewMatrix = uboMatricesAndUserInput.mViewMatrix;
 	vec3 eyePosVS = vec3(0.0, 0.0, 0.0);
 	vec3 toEyeNrmVS = normalize(eyePosVS - posVS);
 
 	// directional lights
 	for (uint i = uboLights.mRangesAmbientDirectional[2]; i < uboLights.mRangesAmbientDirectional[3]; ++i) {
-		vec3 toLightDirVS = normalize(-uboLights.mLightData[i].mDirection.xyz);
+		vec3 toLightDirVS = normalize(-(mat3(viewMatrix) * uboLights.mLightData[i].mDirection.xyz));
 		vec3 dirLightIntensity = uboLights.mLightData[i].mColor.rgb;
 		diffAndSpec += dirLightIntensity * calc_blinn_phong_contribution(toLightDirVS, toEyeNrmVS, normalVS, diff, spec, shini);
 	}
 
+	if (uboMatricesAndUserInput.mClusteringParams.w == 2.0) {
+		// light volumes: the point and spot lights are added by drawing their volumes with light_volume.vert/frag
+		return diffAndSpec;
+	}
+
+	if (uboMatricesAndUserInput.mClusteringParams.w == 3.0) {
+		// stochastic: a fixed number of point and spot light samples per fragment, which is accumulated over time in main()
+		return diffAndSpec + calc_stochastic_illumination_in_vs(viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini);
+	}
+
+	if (uboMatricesAndUserInput.mClusteringParams.w == 1.0) {
+		// clustered shading: only the point and spot lights which affect this fragment's cluster
+		uvec2 cluster = ssboClusters.mClusters[find_light_cluster(posVS)];
+		for (uint j = 0; j < cluster.y; ++j) {
+			uint i = ssboClusters.mLightIndices[cluster.x + j];
+			diffAndSpec += i >= uboLights.mRangesPointSpot[0] && i < uboLights.mRangesPointSpot[1]
+				? calc_point_light_contribution(i, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini)
+				: calc_spot_light_contribution (i, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini);
+		}
+		return diffAndSpec;
+	}
+
 	// point lights
-	for (uint i = uboLights.mRangesPointSpot[0]; i < uboLights.mRangesPointSpot[1]; ++i)
-	{
-		vec3 lightPosVS = uboLights.mLightData[i].mPosition.xyz;
-		vec3 toLight = lightPosVS - posVS;
-		float distSq = dot(toLight, toLight);
-		float dist = sqrt(distSq);
-		vec3 toLightNrm = toLight / dist;
-
-		float atten = calc_attenuation(uboLights.mLightData[i].mAttenuation, dist, distSq);
-		vec3 intensity = uboLights.mLightData[i].mColor.rgb / atten;
-		diffAndSpec += intensity * calc_blinn_phong_contribution(toLightNrm, toEyeNrmVS, normalVS, diff, spec, shini);
+	for (uint i = uboLights.mRangesPointSpot[0]; i < uboLights.mRangesPointSpot[1]; ++i) {
+		diffAndSpec += calc_point_light_contribution(i, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini);
 	}
 
 	// spot lights
-	for (uint i = uboLights.mRangesPointSpot[2]; i < uboLights.mRangesPointSpot[3]; ++i)
-	{
-		vec3 lightPosVS = uboLights.mLightData[i].mPosition.xyz;
-		vec3 toLight = lightPosVS - posVS;
-		float distSq = dot(toLight, toLight);
-		float dist = sqrt(distSq);
-		vec3 toLightNrm = toLight / dist;
-
-		float atten = calc_attenuation(uboLights.mLightData[i].mAttenuation, dist, distSq);
-		vec3 intensity = uboLights.mLightData[i].mColor.rgb / atten;
-
-		vec3 dirVS = uboLights.mLightData[i].mDirection.xyz;
-		float cosOfHalfOuter = uboLights.mLightData[i].mAnglesFalloff[0];
-		float cosOfHalfInner = uboLights.mLightData[i].mAnglesFalloff[1];
-		float falloff = uboLights.mLightData[i].mAnglesFalloff[2];
-		float cosAlpha = dot(-toLightNrm, dirVS);
-		float da = cosAlpha - cosOfHalfOuter;
-		float fade = cosOfHalfInner - cosOfHalfOuter;
-		intensity *= da <= 0.0 ? 0.0 : pow(min(1.0, da / max(0.0001, fade)), falloff);
-
-		diffAndSpec += intensity * calc_blinn_phong_contribution(toLightNrm, toEyeNrmVS, normalVS, diff, spec, shini);
+	for (uint i = uboLights.mRangesPointSpot[2]; i < uboLights.mRangesPointSpot[3]; ++i) {
+		diffAndSpec += calc_spot_light_contribution(i, viewMatrix, posVS, toEyeNrmVS, normalVS, diff, spec, shini);
 	}
 
 	return diffAndSpec;
@@ -357,7 +460,11 @@ void main()
 	vec3 diffAndSpecIllumination = calc_illumination_in_vs(positionVS, normalVS, diff, spec, shininess);
 
 	// Add all together:
-	oFragColor = vec4(ambientIllumination + emissive + diffAndSpecIllumination, 1.0);
+	vec3 color = ambientIllumination + emissive + diffAndSpecIllumination;
+	if (uboMatricesAndUserInput.mClusteringParams.w == 3.0) {
+		color = blend_with_history(color, positionVS);
+	}
+	oFragColor = vec4(color, 1.0);
 }
 // -------------------------------------------------------
 
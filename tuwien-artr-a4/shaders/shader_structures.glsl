@@ -14,6 +14,16 @@ struct matrices_and_user_input {
 	mat4 mCamPos;
 	// x = tessellation factor, y = displacement strength, z = PN triangles on/off, w = reconstruct position from depth on/off
 	vec4 mUserInput;
+	// x = near plane distance, y = far plane distance, z = light cutoff intensity, w = point and spot lights: 0 = all per fragment, 1 = clustered shading, 2 = light volumes, 3 = stochastic
+	vec4 mClusteringParams;
+	// transforms from view space into the previous frame's clip space (for temporal accumulation)
+	mat4 mViewToHistoryClipMatrix;
+	// x = light samples per pixel, y = candidates per light sample, z = temporal blend factor (1 = no history), w = frame index (random seed)
+	vec4 mStochasticLightsParams;
+	// projection matrix without the jitter of temporal anti-aliasing
+	mat4 mUnjitteredProjMatrix;
+	// transforms from view space into the previous frame's (unjittered) clip space (for the velocity G-Buffer target)
+	mat4 mViewToPrevClipMatrix;
 };
 
 struct PushConstants {
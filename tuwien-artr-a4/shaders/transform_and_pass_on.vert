@@ -30,6 +30,9 @@ layout (location = 0) out VertexData {
 	vec3 tangentOS;
 	vec3 bitangentOS;
 } v_out;
+
+// Must produce exactly the same depth values as depth_only.vert:
+invariant gl_Position;
 // -------------------------------------------------------
 
 // ###### VERTEX SHADER MAIN #############################
@@ -1,14 +1,19 @@
 #version 430 core
 
 layout(push_constant) uniform PushConstants {
-	mat4 pvmtMatrix;
-	vec4 uColor;
+	mat4 pvMatrix;
+	float uOpacity;
 };
 
 layout (location = 0) in vec4 aVertexPosition; 
+// per-instance attributes:
+layout (location = 1) in mat4 aModelMatrix;
+layout (location = 5) in vec4 aColor;
+
+layout (location = 0) flat out vec4 vColor;
 
 void main()
 {	
-	gl_Position = pvmtMatrix * aVertexPosition;
+	vColor = vec4(aColor.rgb, uOpacity);
+	gl_Position = pvMatrix * aModelMatrix * aVertexPosition;
 }
-